@@ -7,6 +7,7 @@ It will presumably never be useful for the DOS or OS/2 platforms.
 See 'pdccolor.txt' for a rationale of how this works. */
 
    #include <stdlib.h>
+   #include <string.h>
    #include <assert.h>
 
 #define PACKED_RGB uint32_t
@@ -71,6 +72,8 @@ int PDC_init_palette( void)
 
 void PDC_free_palette( void)
 {
+   if( SP && SP->opaque)
+      PDC_reset_pair_rgbs( -1);
    if( rgbs)
       free( rgbs);
    rgbs = NULL;
@@ -115,6 +118,8 @@ int PDC_set_palette_entry( const int idx, const PACKED_RGB rgb)
       palette_size = new_size;
       }
    rval = (rgbs[idx] == rgb ? 1 : 0);
+   if( !rval && SP && SP->opaque)
+      PDC_reset_pair_rgbs( -1);
    rgbs[idx] = rgb;
    return( rval);
 }
@@ -167,12 +172,19 @@ static PACKED_RGB dimmed_color( PACKED_RGB ival)
 }
 
 
-void PDC_get_rgb_values( const chtype srcp,
+/* The attributes that can alter a pair's colors are boiled down to three
+bits,  used to index the colors cached for that pair (see PDC_PAIR_RGBS
+in curspriv.h),  plus whether to swap the result.  Blinking is folded
+in according to the current blink state,  so toggling it needs no
+cache invalidation. */
+
+#define RGB_INTENSIFY_FORE      1
+#define RGB_INTENSIFY_BACK      2
+#define RGB_DIM                 4
+
+static void _resolve_rgb_values( const int color, const int variant,
             PACKED_RGB *foreground_rgb, PACKED_RGB *background_rgb)
 {
-    const int color = (int)(( srcp & A_COLOR) >> PDC_COLOR_SHIFT);
-    bool reverse_colors = ((srcp & A_REVERSE) ? TRUE : FALSE);
-    bool intensify_backgnd = FALSE;
     bool default_foreground = FALSE, default_background = FALSE;
     int foreground_index, background_index;
 
@@ -186,34 +198,104 @@ void PDC_get_rgb_values( const chtype srcp,
     else
         *background_rgb = PDC_get_palette_entry( background_index);
 
-    if( srcp & A_BLINK)
-    {
-        if( !(SP->termattrs & A_BLINK))   /* convert 'blinking' to 'bold' */
-            intensify_backgnd = TRUE;
-        else if( PDC_blink_state)
-            reverse_colors ^= 1;
-    }
     if( default_foreground)
         *foreground_rgb = (PACKED_RGB)-1;
-    else if( srcp & A_BOLD & ~SP->termattrs)
+    else if( variant & RGB_INTENSIFY_FORE)
         *foreground_rgb = intensified_color( *foreground_rgb);
 
     if( default_background)
         *background_rgb = (PACKED_RGB)-1;
-    else if( intensify_backgnd)
+    else if( variant & RGB_INTENSIFY_BACK)
         *background_rgb = intensified_color( *background_rgb);
-    if( srcp & A_DIM)
+    if( variant & RGB_DIM)
     {
         if( !default_foreground)
            *foreground_rgb = dimmed_color( *foreground_rgb);
         if( !default_background)
            *background_rgb = dimmed_color( *background_rgb);
     }
-    if( reverse_colors)
+}
+
+void PDC_get_rgb_values( const chtype srcp,
+            PACKED_RGB *foreground_rgb, PACKED_RGB *background_rgb)
+{
+    const int color = (int)(( srcp & A_COLOR) >> PDC_COLOR_SHIFT);
+    struct _opaque_screen_t *optr = SP->opaque;
+    bool reverse_colors = ((srcp & A_REVERSE) ? TRUE : FALSE);
+    PDC_PAIR_RGBS *cached;
+    int variant = 0;
+
+    if( srcp & A_BLINK)
+    {
+        if( !(SP->termattrs & A_BLINK))   /* convert 'blinking' to 'bold' */
+            variant |= RGB_INTENSIFY_BACK;
+        else if( PDC_blink_state)
+            reverse_colors ^= 1;
+    }
+    if( srcp & A_BOLD & ~SP->termattrs)
+        variant |= RGB_INTENSIFY_FORE;
+    if( srcp & A_DIM)
+        variant |= RGB_DIM;
+
+    if( color >= optr->pair_rgbs_allocated)
+    {
+        int new_size = (optr->pair_rgbs_allocated ? optr->pair_rgbs_allocated : 64);
+        PDC_PAIR_RGBS *new_rgbs;
+
+        while( new_size <= color)
+            new_size *= 2;
+        new_rgbs = (PDC_PAIR_RGBS *)realloc( optr->pair_rgbs,
+                                    new_size * sizeof( PDC_PAIR_RGBS));
+        if( !new_rgbs)          /* just go without the cache */
+        {
+            if( reverse_colors)
+                _resolve_rgb_values( color, variant, background_rgb, foreground_rgb);
+            else
+                _resolve_rgb_values( color, variant, foreground_rgb, background_rgb);
+            return;
+        }
+        memset( new_rgbs + optr->pair_rgbs_allocated, 0,
+               (new_size - optr->pair_rgbs_allocated) * sizeof( PDC_PAIR_RGBS));
+        optr->pair_rgbs = new_rgbs;
+        optr->pair_rgbs_allocated = new_size;
+    }
+
+    cached = optr->pair_rgbs + color;
+    if( !(cached->valid & (1 << variant)))
+    {
+        _resolve_rgb_values( color, variant, &cached->rgb[variant][0],
+                                             &cached->rgb[variant][1]);
+        cached->valid |= (unsigned char)( 1 << variant);
+    }
+    *foreground_rgb = cached->rgb[variant][reverse_colors];
+    *background_rgb = cached->rgb[variant][!reverse_colors];
+}
+
+/* As above,  but for a cell that may carry its own RGB colors (see
+wadd_rgb_ch() in pdcurses/addchstr.c);  'cell_rgb' points to its
+foreground and background in the plane,  or is NULL.  Reversal still
+applies to such colors;  bold,  dim and blink intensification don't. */
+
+void PDC_get_cell_rgb_values( const chtype srcp, const uint32_t *cell_rgb,
+            PACKED_RGB *foreground_rgb, PACKED_RGB *background_rgb)
+{
+    PDC_get_rgb_values( srcp, foreground_rgb, background_rgb);
+    if( (srcp & PDC_RGB_CELL) && cell_rgb)
     {
-        const PACKED_RGB temp = *foreground_rgb;
+        bool reverse_colors = ((srcp & A_REVERSE) ? TRUE : FALSE);
 
-        *foreground_rgb = *background_rgb;
-        *background_rgb = temp;
+        if( (srcp & A_BLINK) && (SP->termattrs & A_BLINK) && PDC_blink_state)
+            reverse_colors ^= 1;
+        if( reverse_colors)
+        {
+            PACKED_RGB *tptr = foreground_rgb;
+
+            foreground_rgb = background_rgb;
+            background_rgb = tptr;
+        }
+        if( cell_rgb[0] != PDC_RGB_NONE)
+            *foreground_rgb = cell_rgb[0];
+        if( cell_rgb[1] != PDC_RGB_NONE)
+            *background_rgb = cell_rgb[1];
     }
 }
@@ -12,6 +12,8 @@ typedef uint32_t PACKED_RGB;
 int PDC_init_palette( void);
 void PDC_get_rgb_values( const chtype srcp,
             PACKED_RGB *foreground_rgb, PACKED_RGB *background_rgb);
+void PDC_get_cell_rgb_values( const chtype srcp, const uint32_t *cell_rgb,
+            PACKED_RGB *foreground_rgb, PACKED_RGB *background_rgb);
 int PDC_set_palette_entry( const int idx, const PACKED_RGB rgb);
 PACKED_RGB PDC_get_palette_entry( const int idx);
 void PDC_free_palette( void);
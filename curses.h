@@ -1827,6 +1827,12 @@ PDCEX  int     mvwaddrawch(WINDOW *, int, int, chtype);
 PDCEX  int     mvwdeleteln(WINDOW *, int, int);
 PDCEX  int     mvwinsertln(WINDOW *, int, int);
 PDCEX  int     mvwinsrawch(WINDOW *, int, int, chtype);
+PDCEX  WINDOW *newpad_sparse(int, int);
+PDCEX  WINDOW *newpad_file(const char *, int);
+PDCEX  int     file_pad_lines(WINDOW *, bool *);
+PDCEX  int     wadd_rgb_ch(WINDOW *, const chtype, const int, const int);
+PDCEX  int     waddrgbnstr(WINDOW *, const chtype *, const int *, int);
+PDCEX  int     mvwaddrgbnstr(WINDOW *, int, int, const chtype *, const int *, int);
 PDCEX  int     raw_output(bool);
 PDCEX  int     resize_term(int, int);
 PDCEX  WINDOW *resize_window(WINDOW *, int, int);
@@ -1849,6 +1855,8 @@ PDCEX  int     PDC_set_bold(bool);
 PDCEX  int     PDC_set_line_color(short);
 PDCEX  void    PDC_set_title(const char *);
 PDCEX  int     PDC_set_box_type( const int box_type);
+PDCEX  int     PDC_blit_rgb(WINDOW *, int, int, const unsigned char *,
+                             int, int, int, int);
 
 PDCEX  int     PDC_clearclipboard(void);
 PDCEX  int     PDC_freeclipboard(char *);
@@ -1930,6 +1938,12 @@ PDCEX  int     wunderscore(WINDOW *);
 #define PDC_BOX_DOUBLED_V        1
 #define PDC_BOX_DOUBLED_H        2
 
+/* modes for PDC_blit_rgb() */
+
+#define PDC_BLIT_HALF_BLOCK      0
+#define PDC_BLIT_QUADRANT        1
+#define PDC_BLIT_DIRECT          2
+
 /* return codes from PDC_getclipboard() and PDC_setclipboard() calls */
 
 #define PDC_CLIP_SUCCESS         0
@@ -45,6 +45,12 @@ typedef struct           /* structure for ripped off lines */
 #define _SUBWIN    0x01  /* window is a subwindow */
 #define _PAD       0x10  /* X/Open Pad. */
 #define _SUBPAD    0x20  /* X/Open subpad. */
+#define _SPARSE    0x40  /* pad whose unwritten lines share one blank line */
+#define _FILEPAD   0x80  /* pad showing a file,  from newpad_file() */
+
+/* A sparse pad keeps its shared blank line just past the last line */
+
+#define _SPARSE_BLANK_LINE(win) ((win)->_y[(win)->_maxy])
 
 /* Miscellaneous */
 
@@ -96,15 +102,30 @@ int     PDC_init_atrtab(void);
 void    PDC_free_atrtab(void);
 WINDOW *PDC_makelines(WINDOW *);
 WINDOW *PDC_makenew(int, int, int, int);
+WINDOW *PDC_makesparselines(WINDOW *);
+void    PDC_free_sparse_lines(WINDOW *);
+chtype *PDC_writable_line(WINDOW *, const int y);
+bool    PDC_release_line(WINDOW *, const int y, const chtype blank);
+void    PDC_free_file_pad(WINDOW *);
+uint32_t *PDC_rgb_plane(WINDOW *, int *stride, const bool create);
+void    PDC_free_rgb_plane(WINDOW *);
+void    PDC_scroll_rgb_plane(WINDOW *, const int top, const int n_lines, const int n);
+void    PDC_shift_rgb_plane(WINDOW *, const int y, const int x, int n);
+bool    PDC_same_rgb(const uint32_t *, const uint32_t *);
+void    PDC_copy_rgb(uint32_t *drgb, const uint32_t *srgb,
+                     const int first, const int last);
 int     PDC_mouse_in_slk(int, int);
 void    PDC_slk_free(void);
 void    PDC_slk_initialize(void);
 void    PDC_sync(WINDOW *);
 PDCEX void    PDC_set_default_colors( const int, const int);
+void    PDC_reset_pair_rgbs( const int pair);
 void    PDC_set_changed_cells_range( WINDOW *, const int y, const int start, const int end);
 void    PDC_mark_line_as_changed( WINDOW *win, const int y);
 void    PDC_mark_cells_as_changed( WINDOW *, const int y, const int start, const int end);
 void    PDC_mark_cell_as_changed( WINDOW *, const int y, const int x);
+int     PDC_n_blinking_lines(void);
+void    PDC_redraw_blinking_cells(void);
 
 #ifdef PDC_WIDE
 int     PDC_mbtowc(wchar_t *, const char *, size_t);
@@ -147,6 +168,44 @@ PDCEX int PDC_wcwidth( const int32_t ucs);
     typedef int32_t hash_idx_t;
 #endif
 
+/* Each line of SP->lastscr has a small Bloom filter of the color pairs
+on it,  so doupdate() can tell which lines might show a changed pair. */
+
+#define PDC_PAIR_BLOOM_BIT( pair)   (1UL << ((pair) & 31))
+
+/* Cells written with wadd_rgb_ch() and friends carry PDC_RGB_CELL
+(one of the chtype bits not otherwise used),  and take their colors
+from the RGB plane of the window (see addchstr.c) rather than from
+their color pair.  PDC_RGB_NONE in the plane means 'use the pair's
+color'.  There's no spare bit in a 32-bit chtype. */
+
+#ifdef CHTYPE_32
+   #define PDC_RGB_CELL   ((chtype)0)
+#else
+   #define PDC_RGB_CELL   ((chtype)1 << 63)
+#endif
+#define PDC_RGB_NONE      ((uint32_t)-1)
+
+/* Cells carrying PDC_RGB_CELL match only if their RGB plane values
+match too.  'srgb' and 'drgb' point at the plane values of the lines,
+or are NULL for lines without a plane. */
+
+#define PDC_CELL_RGB( row, x)   ((row) ? (row) + 2 * (x) : NULL)
+#define PDC_SAME_CELL( src, dest, srgb, drgb, x)  ((src)[x] == (dest)[x] && \
+            (!((src)[x] & PDC_RGB_CELL) || \
+             PDC_same_rgb( PDC_CELL_RGB( srgb, x), PDC_CELL_RGB( drgb, x))))
+
+/* Foreground and background colors of a color pair as resolved by
+PDC_get_rgb_values() in common/pdccolor.c,  for each combination of the
+attributes (other than A_REVERSE) that can alter them.  Bit n of
+'valid' is set once rgb[n] has been filled in. */
+
+typedef struct
+{
+   uint32_t rgb[8][2];
+   unsigned char valid;
+} PDC_PAIR_RGBS;
+
 struct _opaque_screen_t
 {
    struct _pdc_pair *pairs;
@@ -160,6 +219,20 @@ struct _opaque_screen_t
    unsigned trace_flags;
    bool want_trace_fflush;
    FILE *output_fd, *input_fd;
+   struct _pdc_file_pad *file_pads;
+   PDC_PAIR_RGBS *pair_rgbs;
+   int pair_rgbs_allocated;
+   unsigned char *pairs_to_redraw;     /* bit per pair changed since */
+   int pairs_to_redraw_size;           /* the last doupdate() */
+   int min_pair_to_redraw, max_pair_to_redraw;
+   unsigned long pair_blooms_to_redraw;
+   chtype attrs_to_redraw;
+   unsigned long *line_pair_blooms;    /* pairs on each SP->lastscr line */
+   int line_pair_blooms_lines;
+   struct _pdc_rgb_plane *rgb_planes;
+   int *blink_spans;                   /* A_BLINK columns on each */
+   int blink_spans_lines;              /* SP->lastscr line;  see */
+   int n_blinking_lines;               /* refresh.c */
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,154 @@
+/* Checks file-backed pads (see newpad_file()):  lines of a small file
+are laid out cell for cell as waddch() would lay them out,  including
+fullwidth characters and combining marks in wide-character builds,
+and writes to the pad are refused.
+
+   fpadtest
+
+   Nothing needs to be typed;  the results are shown after endwin(),
+and the exit status is non-zero if any check failed,  so that this can
+be run unattended (e.g.,  by ctest). */
+
+#include <curses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef PDC_WIDE
+#include <wchar.h>
+#include <locale.h>
+#endif
+
+#define TEST_FILE_NAME "fpadtest.tmp"
+#define PAD_COLS       12
+
+static int n_failures = 0;
+static char failures[20][80];
+
+static void check( const bool passed, const char *what)
+{
+    if( !passed)
+    {
+        if( n_failures < 20)
+            snprintf( failures[n_failures], 80, "%s", what);
+        n_failures++;
+    }
+}
+
+   /* Text of cell (line, col) of the virtual screen,  after the pad
+      has been copied there with pnoutrefresh() */
+
+static chtype screen_text( const int line, const int col)
+{
+    return( mvwinch( curscr, line, col) & A_CHARTEXT);
+}
+
+static const char *test_text =
+      "a\tb\x01" "c\n"
+#ifdef PDC_WIDE
+      "a\xe4\xb8\xad" "b\xe6\x96\x87" "c\n"        /* U+4E2D, U+6587 */
+      "e\xcc\x81" "x\xcc\x82\xcc\x83" "y\n"        /* U+0301; U+0302, U+0303 */
+      "abcdefghijk\xe4\xb8\xad\n"                  /* fullwidth at the edge */
+#endif
+      "last line,  not terminated";
+
+#ifdef USING_COMBINING_CHARACTER_SCHEME
+      /* see 'addch.c' for how fullwidth and combined characters are stored */
+
+#define DUMMY_CHAR_NEXT_TO_FULLWIDTH 0x110000
+
+static bool is_combination( const int line, const int col,
+                            const wchar_t *expected)
+{
+    cchar_t cell;
+    wchar_t wtext[10];
+    attr_t attrs;
+    short pair;
+
+    if( mvwin_wch( curscr, line, col, &cell) == ERR
+             || getcchar( &cell, wtext, &attrs, &pair, NULL) == ERR)
+        return( FALSE);
+    return( !wcscmp( wtext, expected));
+}
+#endif
+
+int main( void)
+{
+    FILE *ofile = fopen( TEST_FILE_NAME, "wb");
+    WINDOW *pad;
+    bool complete;
+    int i, n_lines;
+
+    if( !ofile)
+    {
+        fprintf( stderr, "Couldn't create " TEST_FILE_NAME "\n");
+        return( -1);
+    }
+    fputs( test_text, ofile);
+    fclose( ofile);
+
+#ifdef PDC_WIDE
+        /* character widths may come from the C library,  which needs */
+        /* a UTF-8 locale to know them;  ctest may not have provided one */
+    setlocale( LC_ALL, "");
+    if( MB_CUR_MAX == 1)
+        setlocale( LC_ALL, "C.UTF-8");
+#endif
+    initscr( );
+    pad = newpad_file( TEST_FILE_NAME, PAD_COLS);
+    check( pad != NULL, "newpad_file() failed");
+    if( pad)
+    {
+        do
+            n_lines = file_pad_lines( pad, &complete);
+        while( !complete);
+        pnoutrefresh( pad, 0, 0, 0, 0, n_lines - 1, PAD_COLS - 1);
+
+                /* tab expanded;  control character shown as by unctrl() */
+        check( screen_text( 0, 0) == 'a' && screen_text( 0, 7) == ' '
+                  && screen_text( 0, 8) == 'b', "tab not expanded");
+        check( screen_text( 0, 9) == '^' && screen_text( 0, 10) == 'A'
+                  && screen_text( 0, 11) == 'c', "control character not shown");
+#ifdef PDC_WIDE
+        check( screen_text( 1, 0) == 'a' && screen_text( 1, 1) == 0x4e2d
+                && screen_text( 1, 3) == 'b' && screen_text( 1, 4) == 0x6587
+                && screen_text( 1, 6) == 'c', "fullwidth text misplaced");
+#ifdef USING_COMBINING_CHARACTER_SCHEME
+        check( screen_text( 1, 2) == DUMMY_CHAR_NEXT_TO_FULLWIDTH
+                && screen_text( 1, 5) == DUMMY_CHAR_NEXT_TO_FULLWIDTH,
+                "no dummy cell after fullwidth character");
+        check( is_combination( 2, 0, L"e\x301")
+                && is_combination( 2, 1, L"x\x302\x303"),
+                "combining marks not merged");
+#endif
+        check( screen_text( 2, 2) == 'y' && screen_text( 2, 3) == ' ',
+                "combining marks given columns of their own");
+        check( screen_text( 3, 10) == 'k' && screen_text( 3, 11) == ' ',
+                "fullwidth character split at right edge");
+#endif
+        for( i = 0; i < 9; i++)
+            check( screen_text( n_lines - 1, i) == (chtype)"last line"[i],
+                   "unterminated last line not shown");
+
+                /* file pads are read-only */
+        check( mvwaddch( pad, 0, 0, 'x') == ERR, "waddch() allowed");
+        check( mvwaddstr( pad, 0, 1, "xyz") == ERR, "waddstr() allowed");
+        check( mvwinsch( pad, 0, 0, 'x') == ERR, "winsch() allowed");
+        check( wclrtoeol( pad) == ERR, "wclrtoeol() allowed");
+        check( wclear( pad) == ERR, "wclear() allowed");
+        check( wdeleteln( pad) == ERR, "wdeleteln() allowed");
+        check( winsertln( pad) == ERR, "winsertln() allowed");
+        check( wborder( pad, 0, 0, 0, 0, 0, 0, 0, 0) == ERR,
+                   "wborder() allowed");
+        pnoutrefresh( pad, 0, 0, 0, 0, n_lines - 1, PAD_COLS - 1);
+        check( screen_text( 0, 0) == 'a' && screen_text( 0, 8) == 'b',
+                   "file pad text was overwritten");
+        delwin( pad);
+    }
+    endwin( );
+    remove( TEST_FILE_NAME);
+
+    for( i = 0; i < n_failures && i < 20; i++)
+        printf( "FAILED: %s\n", failures[i]);
+    printf( "%d check(s) failed\n", n_failures);
+    return( n_failures ? -1 : 0);
+}
@@ -0,0 +1,116 @@
+/* Pad memory and throughput benchmark,  for an "append and scroll"
+workload like that of a log viewer:  lines are appended to a tall pad,
+with the view following the newest line,  and then the whole pad is
+paged back through from the top.
+
+   padbench [-d] [pad lines] [lines to append]
+
+   By default,  a sparse pad (see newpad_sparse()) is used;  -d uses an
+ordinary newpad() instead,  for comparison.  Results are shown after
+endwin(),  including peak memory use where that can be determined. */
+
+#include <curses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __unix__
+#include <sys/time.h>
+#include <sys/resource.h>
+
+static double get_seconds( void)
+{
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.;
+}
+
+static long peak_memory_kbytes( void)
+{
+    struct rusage usage;
+
+    getrusage( RUSAGE_SELF, &usage);
+    return( usage.ru_maxrss);
+}
+#else
+#include <time.h>
+
+static double get_seconds( void)
+{
+    return (double)clock( ) / (double)CLOCKS_PER_SEC;
+}
+
+static long peak_memory_kbytes( void)
+{
+    return( -1L);
+}
+#endif
+
+int main( int argc, char **argv)
+{
+    WINDOW *pad;
+    bool dense = FALSE;
+    long n_lines = 1000000, n_appends = 20000, i, n_pages = 0;
+    double t0, append_time, page_time;
+    long mem_before;
+    int argn = 0;
+
+    for( i = 1; i < argc; i++)
+        if( !strcmp( argv[i], "-d"))
+            dense = TRUE;
+        else if( argn++)
+            n_appends = atol( argv[i]);
+        else
+            n_lines = atol( argv[i]);
+
+    initscr( );
+    noecho( );
+    curs_set( 0);
+    mem_before = peak_memory_kbytes( );
+#ifdef __PDCURSES__
+    pad = (dense ? newpad( (int)n_lines, COLS)
+                 : newpad_sparse( (int)n_lines, COLS));
+#else
+    dense = TRUE;
+    pad = newpad( (int)n_lines, COLS);
+#endif
+    if( !pad)
+    {
+        endwin( );
+        printf( "Couldn't create a %ld-line pad\n", n_lines);
+        return( -1);
+    }
+    if( n_appends > n_lines)
+        n_appends = n_lines;
+
+    t0 = get_seconds( );
+    for( i = 0; i < n_appends; i++)
+    {
+        const long top = (i < LINES ? 0 : i - LINES + 1);
+
+        mvwprintw( pad, (int)i, 0, "%8ld: the quick brown fox jumps over "
+                            "the lazy dog", i);
+        prefresh( pad, (int)top, 0, 0, 0, LINES - 1, COLS - 1);
+    }
+    append_time = get_seconds( ) - t0;
+
+    t0 = get_seconds( );
+    for( i = 0; i < n_lines; i += LINES, n_pages++)
+        prefresh( pad, (int)i, 0, 0, 0, LINES - 1, COLS - 1);
+    page_time = get_seconds( ) - t0;
+
+    delwin( pad);
+    endwin( );
+
+    printf( "%s pad, %ld lines x %d columns\n",
+                 (dense ? "Dense" : "Sparse"), n_lines, COLS);
+    printf( "Appended %ld lines: %.0f lines/second\n", n_appends,
+                 (double)n_appends / (append_time ? append_time : 1e-6));
+    printf( "Paged through %ld screens: %.0f screens/second\n", n_pages,
+                 (double)n_pages / (page_time ? page_time : 1e-6));
+    if( mem_before >= 0)
+        printf( "Peak memory: %ld KB (%ld KB before creating the pad)\n",
+                 peak_memory_kbytes( ), mem_before);
+    return( 0);
+}
@@ -0,0 +1,69 @@
+/* doupdate() rate benchmark:  one character cell is changed and the
+screen updated,  over and over,  for three seconds.  With so little to
+draw,  this mostly measures the fixed cost of an update (for X11,  that
+includes any waiting on the server).
+
+   updbench
+
+   Results are shown after endwin().  For X11,  compare the rate with
+that of "updbench -requestsInFlight 0",  which waits for the server to
+finish every update,  as versions before that resource did. */
+
+#include <curses.h>
+#include <stdio.h>
+
+#define INTENTIONALLY_UNUSED_PARAMETER( param) (void)(param)
+
+#define N_SECONDS 3.
+
+#ifdef __unix__
+#include <sys/time.h>
+
+static double get_seconds( void)
+{
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.;
+}
+#else
+#include <time.h>
+
+static double get_seconds( void)
+{
+    return (double)clock( ) / (double)CLOCKS_PER_SEC;
+}
+#endif
+
+int main( int argc, char **argv)
+{
+    long n_updates = 0;
+    double t0, elapsed;
+
+#ifdef XCURSES
+    Xinitscr( argc, argv);
+#else
+    INTENTIONALLY_UNUSED_PARAMETER( argc);
+    INTENTIONALLY_UNUSED_PARAMETER( argv);
+    initscr( );
+#endif
+    noecho( );
+    curs_set( 0);
+    refresh( );
+
+    t0 = get_seconds( );
+    do
+    {
+        mvaddch( (int)(n_updates % LINES), (int)(n_updates / LINES % COLS),
+                 (chtype)('a' + n_updates % 26));
+        wnoutrefresh( stdscr);
+        doupdate( );
+        n_updates++;
+    }
+    while( (elapsed = get_seconds( ) - t0) < N_SECONDS);
+
+    endwin( );
+    printf( "%ld doupdate() calls in %.1f seconds: %.0f/second\n",
+                 n_updates, elapsed, (double)n_updates / elapsed);
+    return( 0);
+}
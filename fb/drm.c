@@ -236,7 +236,7 @@ static int init_drm( const char *dri_device, const char *connector_name)
 
     if( !rval)
     {
-        PDC_fb.framebuf = _drm_framebuffer.data;
+        PDC_fb.video_mem = _drm_framebuffer.data;
         PDC_fb.xres     = _drm_framebuffer.dumb_framebuffer.width;
         PDC_fb.yres     = _drm_framebuffer.dumb_framebuffer.height;
         PDC_fb.bits_per_pixel = 32;
@@ -254,3 +254,26 @@ static void close_drm( void)
 {
     release_framebuffer( &_drm_framebuffer);
 }
+
+/* 'rects' holds n_rects (x1, y1, x2, y2) quadruplets,  x2 and y2 being
+exclusive.  Drivers that scan out directly from the dumb buffer return
+-ENOSYS,  which is fine.  */
+
+void PDC_drm_dirty( const int *rects, const int n_rects)
+{
+    drmModeClip clips[PDC_MAX_DIRTY_RECTS];
+    int i;
+
+    if( n_rects <= 0 || n_rects > PDC_MAX_DIRTY_RECTS
+                     || !_drm_framebuffer.buffer_id)
+        return;
+    for( i = 0; i < n_rects; i++, rects += 4)
+    {
+        clips[i].x1 = (unsigned short)rects[0];
+        clips[i].y1 = (unsigned short)rects[1];
+        clips[i].x2 = (unsigned short)rects[2];
+        clips[i].y2 = (unsigned short)rects[3];
+    }
+    drmModeDirtyFB( _drm_framebuffer.fd, _drm_framebuffer.buffer_id,
+                    clips, (uint32_t)n_rects);
+}
@@ -1,11 +1,17 @@
 #include <wchar.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "curspriv.h"
 #include "pdcfb.h"
@@ -41,41 +47,45 @@ static int64_t _nanoseconds_since_1970( void)
 little strangely.  "When possible",  we check to see if blink_interval
 nanoseconds (currently set to 0.5 seconds) has elapsed since the
 blinking text was drawn.  If it has,  we flip the PDC_blink_state
-bit and redraw all blinking text and the cursor.
+bit and redraw all blinking text (only the spans of each line that
+doupdate() found to hold A_BLINK cells;  see refresh.c) and the cursor.
 
 Currently,  "when possible" is in PDC_napms( ) and in check_key( )
 (see vt/pdckbd.c for the latter).  This does mean that if you set up
 some blinking text,  and then do some processor-intensive stuff and
-aren't checking for keyboard input,  the text will stop blinking. */
+aren't checking for keyboard input,  the text will stop blinking.
+
+If no line holds blinking text and the cursor has only one shape,
+nothing blinks:  the tick is disarmed,  with blinking left 'on',  and
+is only armed again (half a second out) once something blinks. */
 
 void PDC_check_for_blinking( void)
 {
-   static int64_t prev_time = 0;
-   const int64_t t = _nanoseconds_since_1970( );
+   static int64_t prev_time = 0;      /* 0 = tick not armed */
    const int64_t blink_interval = (int64_t)500000000;
+   const int vis = SP->visibility;
+   int64_t t;
 
+   if( !PDC_n_blinking_lines( ) && (vis & 0xff) == (vis >> 8))
+   {
+      PDC_blink_state = 1;
+      prev_time = 0;
+      return;
+   }
+   t = _nanoseconds_since_1970( );
+   if( !prev_time)
+      prev_time = t;
    if( t > prev_time + blink_interval)
    {
-      int x1, y, x2;
+      const int row = SP->cursrow, col = SP->curscol;
 
       prev_time = t;
       PDC_blink_state ^= 1;
-      for( y = 0; y < SP->lines; y++)
-      {
-         chtype *c = curscr->_y[y];
-
-         for( x1 = 0; x1 < SP->cols; x1++)
-            if( c[x1] & A_BLINK)
-            {
-               x2 = x1 + 1;
-               while( x2 < SP->cols && c[x2] & A_BLINK)
-                  x2++;
-               PDC_transform_line( y, x1, x2 - x1, c + x1);
-               x1 = x2;
-            }
-         if( SP->visibility && y == SP->cursrow)
-            PDC_transform_line( y, SP->curscol, 1, c + SP->curscol);
-      }
+      PDC_redraw_blinking_cells( );
+      if( SP->visibility && row >= 0 && row < SP->lines
+                         && col >= 0 && col < SP->cols)
+         PDC_transform_line( row, col, 1, curscr->_y[row] + col);
+      PDC_doupdate( );
    }
 }
 
@@ -139,6 +149,11 @@ void PDC_puts_to_stdout( const char *buff)
    put_to_stdout( buff, (buff ? strlen( buff) : 1));
 }
 
+static void _flush_cell( const int row, const int col);
+
+/* Only the old and new cursor cells are pushed to video memory here;
+anything else drawn since the last PDC_doupdate( ) stays pending. */
+
 void PDC_gotoyx( int row, int col)
 {
     PDC_LOG(("PDC_gotoyx() - called: row %d col %d from row %d col %d\n",
@@ -158,6 +173,7 @@ void PDC_gotoyx( int row, int col)
         PDC_transform_line( SP->cursrow, SP->curscol, 1,
                            curscr->_y[SP->cursrow] + SP->curscol);
         SP->visibility = temp_visibility;
+        _flush_cell( SP->cursrow, SP->curscol);
     }
 
                /* ...then draw the new  */
@@ -167,47 +183,206 @@ void PDC_gotoyx( int row, int col)
         SP->cursrow = row;
         SP->curscol = col;
         PDC_transform_line( row, col, 1, curscr->_y[row] + col);
+        _flush_cell( row, col);
     }
 }
 
-static const uint8_t *_get_raw_glyph_bytes( struct font_info *font, int unicode_point)
+static int _get_glyph_index( struct font_info *font, int unicode_point)
 {
     int glyph_idx = find_psf_or_vgafont_glyph( font, unicode_point);
-    const int font_char_size_in_bytes = (font->width + 7) >> 3;
 
     if( glyph_idx < 0 || glyph_idx >= (int)font->n_glyphs)
         glyph_idx = find_psf_or_vgafont_glyph( font, '?');
     if( glyph_idx < 0)
         glyph_idx = 0;
+    return( glyph_idx);
+}
+
+static const uint8_t *_get_raw_glyph_bytes( struct font_info *font, int unicode_point)
+{
+    const int glyph_idx = _get_glyph_index( font, unicode_point);
+    const int font_char_size_in_bytes = (font->width + 7) >> 3;
+
     return( font->glyphs + glyph_idx * font_char_size_in_bytes * font->height);
 }
 
 extern struct font_info PDC_font_info;
 extern struct video_info PDC_fb;
 
-void PDC_draw_rectangle( const int xpix, const int ypix,
-                  const int xsize, const int ysize, const uint32_t color)
+/* Damage tracking.  For each pixel row y,  pixels _damage_x1[y] up to
+(but not including) _damage_x2[y] have been drawn since the last flush;
+rows outside _damage_y1 <= y < _damage_y2 are known to be undamaged.
+PDC_doupdate( ) copies only those spans from the shadow buffer to video
+memory (and,  on DRM,  tells the driver which rectangles changed).  */
+
+static int *_damage_x1, *_damage_x2;
+static int _damage_y1, _damage_y2;
+
+static void _reset_damage( void)
 {
-    const int line_len = PDC_fb.line_length * 8 / PDC_fb.bits_per_pixel;
-    int x, y;
-    const long video_offset = xpix + ypix * line_len;
+    int y;
 
-    if( PDC_fb.bits_per_pixel == 32)
+    for( y = 0; y < (int)PDC_fb.yres; y++)
     {
-        uint32_t *tptr = (uint32_t *)PDC_fb.framebuf + video_offset;
+        _damage_x1[y] = (int)PDC_fb.xres;
+        _damage_x2[y] = 0;
+    }
+    _damage_y1 = (int)PDC_fb.yres;
+    _damage_y2 = 0;
+}
 
-        for( y = ysize; y; y--, tptr += line_len - xsize)
-            for( x = xsize; x; x--)
-                *tptr++ = color;
+/* The area is clipped to the screen first;  a partial character row at
+the bottom (or column at the right) can otherwise run past the end of
+the _damage_x1/x2 arrays. */
+
+static void _add_damage( const int xpix, const int ypix,
+                  const int xsize, const int ysize)
+{
+    const int x1 = (xpix < 0 ? 0 : xpix);
+    const int y1 = (ypix < 0 ? 0 : ypix);
+    const int x2 = (xpix + xsize > (int)PDC_fb.xres ? (int)PDC_fb.xres
+                                                    : xpix + xsize);
+    const int y2 = (ypix + ysize > (int)PDC_fb.yres ? (int)PDC_fb.yres
+                                                    : ypix + ysize);
+    int y;
+
+    if( !_damage_x1 || x1 >= x2 || y1 >= y2)
+        return;
+    for( y = y1; y < y2; y++)
+    {
+        if( _damage_x1[y] > x1)
+            _damage_x1[y] = x1;
+        if( _damage_x2[y] < x2)
+            _damage_x2[y] = x2;
     }
-    if( PDC_fb.bits_per_pixel == 8)
+    if( _damage_y1 > y1)
+        _damage_y1 = y1;
+    if( _damage_y2 < y2)
+        _damage_y2 = y2;
+}
+
+/* Video memory is usually uncached or write-combined;  reading it back
+(as blending glyphs into it would) is very slow,  and scattered small
+writes are little better.  So we draw into a shadow buffer in ordinary
+RAM,  with the same layout as the video memory,  and copy changed spans
+over in PDC_doupdate( ).  Set PDC_FB_SHADOW=N to draw directly to video
+memory instead (saving memory,  at some cost in speed).  */
+
+int PDC_init_shadow_buffer( void)
+{
+    const char *env = getenv( "PDC_FB_SHADOW");
+
+    _damage_x1 = (int *)malloc( 2 * PDC_fb.yres * sizeof( int));
+    if( !_damage_x1)
+        return( -1);
+    _damage_x2 = _damage_x1 + PDC_fb.yres;
+    _reset_damage( );
+    PDC_fb.framebuf = PDC_fb.video_mem;
+    if( !env || (*env != 'n' && *env != 'N' && *env != '0'))
     {
-        uint8_t *tptr = (uint8_t *)PDC_fb.framebuf + video_offset;
+        const size_t n_bytes = (size_t)PDC_fb.line_length * PDC_fb.yres;
+        void *shadow;
 
-        for( y = ysize; y; y--, tptr += line_len - xsize)
-            for( x = xsize; x; x--)
-                *tptr++ = color;
+                /* 64-byte alignment means that the shadow buffer and video
+                   memory (which is page-aligned) have the same alignment
+                   for any given offset,  so spans can be copied with
+                   aligned loads and stores.  If allocation fails,  we
+                   just draw directly to video memory.  */
+        if( !posix_memalign( &shadow, 64, n_bytes))
+        {
+            memcpy( shadow, PDC_fb.video_mem, n_bytes);
+            PDC_fb.framebuf = shadow;
+        }
     }
+    return( 0);
+}
+
+void PDC_free_shadow_buffer( void)
+{
+    if( PDC_fb.framebuf != PDC_fb.video_mem)
+        free( PDC_fb.framebuf);
+    PDC_fb.framebuf = PDC_fb.video_mem;
+    if( _damage_x1)
+        free( _damage_x1);
+    _damage_x1 = _damage_x2 = NULL;
+}
+
+/* Copies a span from the shadow buffer to video memory.  If both are
+16-byte aligned (as they will be,  given the way spans are rounded off in
+PDC_doupdate( )),  we use non-temporal stores,  which go straight to the
+write-combining buffers instead of evicting useful data from the cache. */
+
+static void _copy_to_video( uint8_t *dest, const uint8_t *src, size_t n_bytes)
+{
+#ifdef __SSE2__
+    if( !(((uintptr_t)dest | (uintptr_t)src) & 15))
+    {
+        while( n_bytes >= 64)
+        {
+            const __m128i v0 = _mm_load_si128( (const __m128i *)src);
+            const __m128i v1 = _mm_load_si128( (const __m128i *)src + 1);
+            const __m128i v2 = _mm_load_si128( (const __m128i *)src + 2);
+            const __m128i v3 = _mm_load_si128( (const __m128i *)src + 3);
+
+            _mm_stream_si128( (__m128i *)dest, v0);
+            _mm_stream_si128( (__m128i *)dest + 1, v1);
+            _mm_stream_si128( (__m128i *)dest + 2, v2);
+            _mm_stream_si128( (__m128i *)dest + 3, v3);
+            dest += 64;
+            src += 64;
+            n_bytes -= 64;
+        }
+        while( n_bytes >= 16)
+        {
+            _mm_stream_si128( (__m128i *)dest,
+                              _mm_load_si128( (const __m128i *)src));
+            dest += 16;
+            src += 16;
+            n_bytes -= 16;
+        }
+    }
+#endif
+    memcpy( dest, src, n_bytes);
+}
+
+static void _run_raster_jobs( void);
+
+/* 'color' is a pixel value,  already in the framebuffer's format.  Any
+queued text is drawn first,  so that it can't land on top of this. */
+
+void PDC_draw_rectangle( const int xpix, const int ypix,
+                  const int xsize, const int ysize, const uint32_t color)
+{
+    const int bytes_per_pixel = (int)PDC_fb.bits_per_pixel / 8;
+    uint8_t *row = (uint8_t *)PDC_fb.framebuf
+                   + (long)ypix * PDC_fb.line_length + xpix * bytes_per_pixel;
+    int x, y;
+
+    _run_raster_jobs( );
+    _add_damage( xpix, ypix, xsize, ysize);
+    for( y = ysize; y; y--, row += PDC_fb.line_length)
+        switch( bytes_per_pixel)
+        {
+            case 4:
+                for( x = 0; x < xsize; x++)
+                    ((uint32_t *)row)[x] = color;
+                break;
+            case 3:
+                for( x = 0; x < xsize * 3; x += 3)
+                {
+                    row[x] = (uint8_t)color;
+                    row[x + 1] = (uint8_t)( color >> 8);
+                    row[x + 2] = (uint8_t)( color >> 16);
+                }
+                break;
+            case 2:
+                for( x = 0; x < xsize; x++)
+                    ((uint16_t *)row)[x] = (uint16_t)color;
+                break;
+            case 1:
+                memset( row, (int)color, xsize);
+                break;
+        }
 }
 
 const chtype MAX_UNICODE = 0x110000;
@@ -326,18 +501,626 @@ static const uint8_t *_get_glyph( const chtype ch, const int cursor_type,
     return( rval);
 }
 
-/* The framebuffer appears to store red,  green,  and blue in the opposite
-order from what the other platforms expect : */
+/* For drawing,  glyphs are expanded to one byte per pixel (0 or 0xff),
+so that the kernels below can pick the foreground or background color
+with a mask instead of testing a bit per pixel.  The font's own glyphs
+are all expanded on first use after a font is loaded;  glyphs altered by
+bold,  italic or line attributes go through a small cache;  and those
+with a cursor or combining characters are expanded each time.
 
-#define SWAP_RED_AND_BLUE( rgb) (((rgb) & 0xff00) | ((rgb) >> 16) | (((rgb) & 0xff) << 16))
+Drawing may be split among several threads (see PDC_doupdate( ) below).
+The font's own masks are shared,  and are always expanded by the main
+thread before any others start drawing.  Everything else a thread needs
+to scribble on (its glyph cache,  scratch space,  and the 24-bit color
+table) lives in its own 'raster_context'. */
 
-void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
+#define GLYPH_CACHE_SIZE 256
+#define MAX_RASTER_THREADS 16
+
+/* 24-bit pixels are stored as three bytes,  least significant first.
+On little-endian machines,  four pixels fill exactly three 32-bit words.
+For the current fg/bg pair,  we build a table of those three words for
+each of the sixteen possible four-pixel masks,  and a glyph row then
+takes a couple of lookups instead of per-pixel shifting and masking.
+(Runs of text share fg/bg,  so the table is rebuilt only on a change.
+A zeroed table is already correct for fg = bg = 0.) */
+
+#if defined( __BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   #define USE_NIBBLE_TABLE_24
+#endif
+
+struct raster_context
+{
+    uint8_t *cache_masks;      /* GLYPH_CACHE_SIZE masks,  or NULL */
+    uint32_t cache_keys[GLYPH_CACHE_SIZE];
+    uint8_t scratch[300 * 8];
+#ifdef USE_NIBBLE_TABLE_24
+    uint32_t table24[16][3];
+    uint32_t table_fg, table_bg;
+#endif
+};
+
+static uint8_t *_glyph_masks;      /* the font's n_glyphs plain masks */
+static struct raster_context _contexts[MAX_RASTER_THREADS];
+
+/* A run of cells with the same attributes,  queued by PDC_transform_line( )
+to be drawn in PDC_doupdate( ).  The cells are copied to _job_text. */
+
+struct raster_job
+{
+    int lineno, x, len, cursor_type;
+    uint32_t fg, bg;        /* pixel values,  or palette indices at 8 bpp */
+    size_t text_offset;
+};
+
+static struct raster_job *_jobs;
+static chtype *_job_text;
+static int _n_jobs, _n_jobs_alloced;
+static size_t _n_job_cells, _n_job_cells_alloced;
+
+void PDC_free_glyph_masks( void)
+{
+    int i;
+
+    _n_jobs = 0;         /* anything queued was for the old font */
+    _n_job_cells = 0;
+    free( _glyph_masks);
+    _glyph_masks = NULL;
+    for( i = 0; i < MAX_RASTER_THREADS; i++)
+    {
+        free( _contexts[i].cache_masks);
+        _contexts[i].cache_masks = NULL;
+    }
+}
+
+static void _expand_glyph( const uint8_t *bits, uint8_t *mask)
 {
     const int font_char_size_in_bytes = (PDC_font_info.width + 7) >> 3;
-    int cursor_to_draw = 0;
-    const int line_len = PDC_fb.line_length * 8 / PDC_fb.bits_per_pixel;
+    int i, j;
+
+    for( i = 0; i < (int)PDC_font_info.height; i++)
+    {
+        for( j = 0; j < (int)PDC_font_info.width; j++)
+            *mask++ = (((bits[j >> 3] << (j & 7)) & 0x80) ? 0xff : 0);
+        bits += font_char_size_in_bytes;
+    }
+}
+
+static void _init_glyph_masks( void)
+{
+    const size_t mask_size = PDC_font_info.width * PDC_font_info.height;
+
+    if( !_glyph_masks)
+    {
+        _glyph_masks = (uint8_t *)malloc( PDC_font_info.n_glyphs * mask_size);
+        if( _glyph_masks)
+        {
+            uint32_t i;
+
+            for( i = 0; i < PDC_font_info.n_glyphs; i++)
+                _expand_glyph( PDC_font_info.glyphs + i * PDC_font_info.charsize,
+                               _glyph_masks + i * mask_size);
+        }
+    }
+}
+
+static const uint8_t *_get_glyph_mask( struct raster_context *ctx,
+                               const chtype ch, const int cursor_type)
+{
+    const size_t mask_size = PDC_font_info.width * PDC_font_info.height;
+    const uint32_t variant = (uint32_t)( (ch & (LINE_ATTRIBS | A_BOLD | A_ITALIC))
+                                                   >> PDC_CHARTEXT_BITS);
+    int c = (int)( ch & A_CHARTEXT);
     uint8_t scratch[300];
 
+    if( !cursor_type && c < (int)MAX_UNICODE && _glyph_masks)
+    {
+        uint32_t key, slot;
+
+        if( _is_altcharset( ch))
+            c = (int)acs_map[c & 0x7f];
+        else if( c < (int)' ' || (c >= 0x80 && c <= 0x9f))
+            c = ' ';
+        key = (uint32_t)_get_glyph_index( &PDC_font_info, c);
+        if( !variant)
+            return( _glyph_masks + key * mask_size);
+        if( !ctx->cache_masks)
+        {
+            ctx->cache_masks = (uint8_t *)malloc( GLYPH_CACHE_SIZE * mask_size);
+            memset( ctx->cache_keys, 0xff, sizeof( ctx->cache_keys));
+        }
+        if( ctx->cache_masks)
+        {
+            key = (key << 12) | variant;
+            slot = (key * 2654435761u) >> 24;
+            if( ctx->cache_keys[slot] != key)
+            {
+                _expand_glyph( _get_glyph( ch, 0, scratch),
+                               ctx->cache_masks + slot * mask_size);
+                ctx->cache_keys[slot] = key;
+            }
+            return( ctx->cache_masks + slot * mask_size);
+        }
+    }
+    _expand_glyph( _get_glyph( ch, cursor_type, scratch), ctx->scratch);
+    return( ctx->scratch);
+}
+
+/* Blit kernels:  each row of the glyph is written in one go,  as
+bg ^ ((fg ^ bg) & mask).  On x86 (where SSE2 is always there on 64-bit
+builds),  four 32-bit pixels are done at a time.
+
+'fg' and 'bg' are pixel values,  already packed for the framebuffer's
+format (see _pack_rgb( ) below),  or palette indices at 8 bits/pixel;
+'line_bytes' is the framebuffer pitch.  One of these is chosen by
+PDC_set_pixel_format( ) to suit the bits per pixel.  */
+
+static void _blit_glyph32( struct raster_context *ctx, uint8_t *row,
+              const long line_bytes,
+              const uint8_t *mask, const uint32_t fg, const uint32_t bg)
+{
+    const int width = (int)PDC_font_info.width;
+    const uint32_t diff = fg ^ bg;
+    int i, j;
+#ifdef __SSE2__
+    const __m128i vbg = _mm_set1_epi32( (int)bg);
+    const __m128i vdiff = _mm_set1_epi32( (int)diff);
+#endif
+
+    INTENTIONALLY_UNUSED_PARAMETER( ctx);
+    for( i = (int)PDC_font_info.height; i; i--, row += line_bytes, mask += width)
+    {
+        uint32_t *dest = (uint32_t *)row;
+
+        j = 0;
+#ifdef __SSE2__
+        for( ; j + 4 <= width; j += 4)
+        {
+            int32_t four_bytes;
+            __m128i m;
+
+            memcpy( &four_bytes, mask + j, 4);
+            m = _mm_cvtsi32_si128( four_bytes);
+            m = _mm_unpacklo_epi8( m, m);
+            m = _mm_unpacklo_epi16( m, m);
+            _mm_storeu_si128( (__m128i *)( dest + j),
+                        _mm_xor_si128( vbg, _mm_and_si128( vdiff, m)));
+        }
+#endif
+        for( ; j < width; j++)
+            dest[j] = bg ^ (diff & (0u - (uint32_t)( mask[j] & 1)));
+    }
+}
+
+static void _blit_glyph16( struct raster_context *ctx, uint8_t *row,
+              const long line_bytes,
+              const uint8_t *mask, const uint32_t fg, const uint32_t bg)
+{
+    const int width = (int)PDC_font_info.width;
+    const uint16_t bg16 = (uint16_t)bg, diff = (uint16_t)( fg ^ bg);
+    int i, j;
+#ifdef __SSE2__
+    const __m128i vbg = _mm_set1_epi16( (short)bg16);
+    const __m128i vdiff = _mm_set1_epi16( (short)diff);
+#endif
+
+    INTENTIONALLY_UNUSED_PARAMETER( ctx);
+    for( i = (int)PDC_font_info.height; i; i--, row += line_bytes, mask += width)
+    {
+        uint16_t *dest = (uint16_t *)row;
+
+        j = 0;
+#ifdef __SSE2__
+        for( ; j + 8 <= width; j += 8)
+        {
+            __m128i m = _mm_loadl_epi64( (const __m128i *)( mask + j));
+
+            m = _mm_unpacklo_epi8( m, m);
+            _mm_storeu_si128( (__m128i *)( dest + j),
+                        _mm_xor_si128( vbg, _mm_and_si128( vdiff, m)));
+        }
+#endif
+        for( ; j < width; j++)
+            dest[j] = (uint16_t)( bg16 ^ (diff & (0u - (unsigned)( mask[j] & 1))));
+    }
+}
+
+static void _blit_glyph24( struct raster_context *ctx, uint8_t *row,
+              const long line_bytes,
+              const uint8_t *mask, const uint32_t fg, const uint32_t bg)
+{
+    const int width = (int)PDC_font_info.width;
+    const uint8_t fg_bytes[3] = { (uint8_t)fg, (uint8_t)( fg >> 8),
+                                  (uint8_t)( fg >> 16) };
+    const uint8_t bg_bytes[3] = { (uint8_t)bg, (uint8_t)( bg >> 8),
+                                  (uint8_t)( bg >> 16) };
+    int i, j;
+#ifdef USE_NIBBLE_TABLE_24
+    uint32_t (*table)[3] = ctx->table24;
+
+    if( fg != ctx->table_fg || bg != ctx->table_bg)
+    {
+        for( i = 0; i < 16; i++)
+        {
+            const uint32_t p0 = ((i & 1) ? fg : bg), p1 = ((i & 2) ? fg : bg);
+            const uint32_t p2 = ((i & 4) ? fg : bg), p3 = ((i & 8) ? fg : bg);
+
+            table[i][0] = (p0 & 0xffffff) | (p1 << 24);
+            table[i][1] = ((p1 >> 8) & 0xffff) | (p2 << 16);
+            table[i][2] = ((p2 >> 16) & 0xff) | (p3 << 8);
+        }
+        ctx->table_fg = fg;
+        ctx->table_bg = bg;
+    }
+#else
+    INTENTIONALLY_UNUSED_PARAMETER( ctx);
+#endif
+
+    for( i = (int)PDC_font_info.height; i; i--, row += line_bytes, mask += width)
+    {
+        uint8_t *dest = row;
+
+        j = 0;
+#ifdef USE_NIBBLE_TABLE_24
+        for( ; j + 4 <= width; j += 4, dest += 12)
+        {
+            uint32_t four_bytes;
+
+                     /* gather the low bits of four mask bytes into a */
+                     /* four-bit index in the top byte of the product */
+            memcpy( &four_bytes, mask + j, 4);
+            memcpy( dest, table[((four_bytes & 0x01010101u)
+                                         * 0x01020408u) >> 24], 12);
+        }
+#endif
+        for( ; j < width; j++, dest += 3)
+        {
+            const uint8_t *src = (mask[j] ? fg_bytes : bg_bytes);
+
+            dest[0] = src[0];
+            dest[1] = src[1];
+            dest[2] = src[2];
+        }
+    }
+}
+
+static void _blit_glyph8( struct raster_context *ctx, uint8_t *row,
+              const long line_bytes,
+              const uint8_t *mask, const uint32_t fg, const uint32_t bg)
+{
+    const int width = (int)PDC_font_info.width;
+    const uint8_t diff = (uint8_t)( fg ^ bg);
+    int i, j;
+
+    INTENTIONALLY_UNUSED_PARAMETER( ctx);
+    for( i = (int)PDC_font_info.height; i; i--, row += line_bytes, mask += width)
+        for( j = 0; j < width; j++)
+            row[j] = (uint8_t)bg ^ (diff & mask[j]);
+}
+
+static void (*_blit_glyph)( struct raster_context *ctx, uint8_t *row,
+              const long line_bytes,
+              const uint8_t *mask, const uint32_t fg, const uint32_t bg);
+
+static void _set_default_field( struct pixel_field *field,
+                     const unsigned offset, const unsigned length)
+{
+    field->offset = offset;
+    field->length = length;
+}
+
+/* Called once the framebuffer is opened.  Returns -1 if we can't handle
+its bits per pixel. */
+
+int PDC_set_pixel_format( void)
+{
+    const bool have_fields = (PDC_fb.red.length || PDC_fb.green.length
+                                    || PDC_fb.blue.length);
+
+    switch( PDC_fb.bits_per_pixel)
+    {
+        case 8:
+            _blit_glyph = _blit_glyph8;   /* palette;  see PDC_transform_line( ) */
+            return( 0);
+        case 16:
+            _blit_glyph = _blit_glyph16;
+            if( !have_fields)       /* assume RGB565 */
+            {
+                _set_default_field( &PDC_fb.red, 11, 5);
+                _set_default_field( &PDC_fb.green, 5, 6);
+                _set_default_field( &PDC_fb.blue, 0, 5);
+            }
+            return( 0);
+        case 24:
+        case 32:
+            _blit_glyph = (PDC_fb.bits_per_pixel == 24 ? _blit_glyph24
+                                                       : _blit_glyph32);
+            if( !have_fields)       /* assume (X)RGB8888 */
+            {
+                _set_default_field( &PDC_fb.red, 16, 8);
+                _set_default_field( &PDC_fb.green, 8, 8);
+                _set_default_field( &PDC_fb.blue, 0, 8);
+            }
+            return( 0);
+    }
+    return( -1);
+}
+
+static uint32_t _pack_component( const uint32_t value,
+                                 const struct pixel_field *field)
+{
+    const uint32_t scaled = (field->length <= 8 ? value >> (8 - field->length)
+                                                : value << (field->length - 8));
+
+    return( scaled << field->offset);
+}
+
+static uint32_t _pack_rgb( const PACKED_RGB rgb)
+{
+    return( _pack_component( rgb & 0xff, &PDC_fb.red)
+          | _pack_component( (rgb >> 8) & 0xff, &PDC_fb.green)
+          | _pack_component( (rgb >> 16) & 0xff, &PDC_fb.blue));
+}
+
+static void _draw_job( struct raster_context *ctx,
+              const struct raster_job *job, const chtype *text)
+{
+    const long line_bytes = (long)PDC_fb.line_length;
+    const int glyph_bytes = (int)( PDC_font_info.width
+                                 * PDC_fb.bits_per_pixel / 8);
+    uint8_t *tptr = (uint8_t *)PDC_fb.framebuf
+                 + job->lineno * PDC_font_info.height * line_bytes
+                 + job->x * glyph_bytes;
+    int i;
+
+    for( i = 0; i < job->len; i++, tptr += glyph_bytes)
+        _blit_glyph( ctx, tptr, line_bytes,
+                     _get_glyph_mask( ctx, text[i], job->cursor_type),
+                     job->fg, job->bg);
+}
+
+/* On a big screen (4K with a small font is well over 100K cells),  a
+full repaint is a lot of glyphs for one core.  So if more than one thread
+is to be used,  PDC_transform_line( ) does everything that touches shared
+state (clipping,  damage,  cursor,  colors) itself,  but only queues the
+runs of text.  PDC_doupdate( ) then splits the screen into bands of text
+rows holding about equal numbers of queued cells;  each thread draws the
+jobs in its band (in queued order,  so overlapping jobs within a row come
+out right),  and all are done before PDC_doupdate( ) copies anything to
+video memory.  A frame with fewer than MIN_CELLS_PER_BAND cells per
+thread uses fewer threads;  small ones are drawn entirely by the calling
+thread,  as they always were.
+
+The number of threads (including the calling one) is PDC_FB_THREADS if
+that's set in the environment,  otherwise the number of processors,  up
+to DEFAULT_MAX_THREADS.  PDC_FB_THREADS=1 draws everything immediately,
+without queueing.  Worker threads are only started once a frame is big
+enough to need them. */
+
+#define MIN_CELLS_PER_BAND 2048
+#define DEFAULT_MAX_THREADS 4
+
+static int _n_threads = 1;
+static pthread_t _workers[MAX_RASTER_THREADS];
+static int _n_workers;        /* worker i + 1 draws band i + 1 */
+static pthread_mutex_t _pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _work_done = PTHREAD_COND_INITIALIZER;
+static bool _band_pending[MAX_RASTER_THREADS];
+static int _n_busy;
+static bool _quit_workers;
+static int _band_start[MAX_RASTER_THREADS + 1];   /* in text rows */
+static int *_row_cells, _n_row_cells_alloced;
+
+void PDC_init_raster_threads( void)
+{
+    const char *env = getenv( "PDC_FB_THREADS");
+
+    if( env)
+        _n_threads = atoi( env);
+    else
+    {
+        const long n_cpus = sysconf( _SC_NPROCESSORS_ONLN);
+
+        _n_threads = (int)( n_cpus < DEFAULT_MAX_THREADS ? n_cpus
+                                                 : DEFAULT_MAX_THREADS);
+    }
+    if( _n_threads < 1)
+        _n_threads = 1;
+    if( _n_threads > MAX_RASTER_THREADS)
+        _n_threads = MAX_RASTER_THREADS;
+}
+
+static void _draw_band( const int band)
+{
+    const int y1 = _band_start[band], y2 = _band_start[band + 1];
+    int i;
+
+    for( i = 0; i < _n_jobs; i++)
+        if( _jobs[i].lineno >= y1 && _jobs[i].lineno < y2)
+            _draw_job( _contexts + band, _jobs + i,
+                       _job_text + _jobs[i].text_offset);
+}
+
+static void *_raster_worker( void *arg)
+{
+    const int band = (int)(intptr_t)arg;
+
+    pthread_mutex_lock( &_pool_mutex);
+    for( ;;)
+    {
+        while( !_band_pending[band] && !_quit_workers)
+            pthread_cond_wait( &_work_ready, &_pool_mutex);
+        if( _quit_workers)
+            break;
+        pthread_mutex_unlock( &_pool_mutex);
+        _draw_band( band);
+        pthread_mutex_lock( &_pool_mutex);
+        _band_pending[band] = FALSE;
+        if( !--_n_busy)
+            pthread_cond_signal( &_work_done);
+    }
+    pthread_mutex_unlock( &_pool_mutex);
+    return( NULL);
+}
+
+/* Starts workers as needed,  and returns the number of bands that can
+actually be drawn (at most 'n_bands').  Workers block all signals,  so
+that (for example) SIGINT is always handled in the main thread.  If a
+thread can't be started,  we settle for the ones we have. */
+
+static int _start_workers( const int n_bands)
+{
+    if( _n_workers < n_bands - 1)
+    {
+        sigset_t all_signals, old_mask;
+
+        sigfillset( &all_signals);
+        pthread_sigmask( SIG_SETMASK, &all_signals, &old_mask);
+        while( _n_workers < n_bands - 1)
+        {
+            if( pthread_create( _workers + _n_workers, NULL, _raster_worker,
+                                (void *)(intptr_t)( _n_workers + 1)))
+            {
+                _n_threads = _n_workers + 1;
+                break;
+            }
+            _n_workers++;
+        }
+        pthread_sigmask( SIG_SETMASK, &old_mask, NULL);
+    }
+    return( n_bands < _n_workers + 1 ? n_bands : _n_workers + 1);
+}
+
+/* Sets _band_start[] so that each band holds about the same number of
+queued cells.  Returns FALSE if out of memory. */
+
+static bool _set_bands( const int n_bands)
+{
+    const int n_rows = SP->lines;
+    size_t cells = 0;
+    int i, band = 0;
+
+    if( _n_row_cells_alloced < n_rows)
+    {
+        int *new_row_cells = (int *)realloc( _row_cells, n_rows * sizeof( int));
+
+        if( !new_row_cells)
+            return( FALSE);
+        _row_cells = new_row_cells;
+        _n_row_cells_alloced = n_rows;
+    }
+    memset( _row_cells, 0, n_rows * sizeof( int));
+    for( i = 0; i < _n_jobs; i++)
+        _row_cells[_jobs[i].lineno < n_rows ? _jobs[i].lineno : n_rows - 1]
+                   += _jobs[i].len;
+    _band_start[0] = 0;
+    for( i = 0; i < n_rows; i++)
+    {
+        cells += (size_t)_row_cells[i];
+        while( band < n_bands - 1
+                 && cells * n_bands >= _n_job_cells * (size_t)( band + 1))
+            _band_start[++band] = i + 1;
+    }
+    while( band < n_bands - 1)
+        _band_start[++band] = n_rows;
+    _band_start[n_bands] = INT_MAX;
+    return( TRUE);
+}
+
+static void _run_raster_jobs( void)
+{
+    int i, n_bands = (int)( _n_job_cells / MIN_CELLS_PER_BAND);
+
+    if( !_n_jobs)
+        return;
+    if( n_bands > _n_threads)
+        n_bands = _n_threads;
+    if( n_bands > 1)
+        n_bands = _start_workers( n_bands);
+    if( n_bands > 1 && _set_bands( n_bands))
+    {
+        pthread_mutex_lock( &_pool_mutex);
+        for( i = 1; i < n_bands; i++)
+            _band_pending[i] = TRUE;
+        _n_busy = n_bands - 1;
+        pthread_cond_broadcast( &_work_ready);
+        pthread_mutex_unlock( &_pool_mutex);
+        _draw_band( 0);
+        pthread_mutex_lock( &_pool_mutex);
+        while( _n_busy)
+            pthread_cond_wait( &_work_done, &_pool_mutex);
+        pthread_mutex_unlock( &_pool_mutex);
+    }
+    else
+        for( i = 0; i < _n_jobs; i++)
+            _draw_job( _contexts, _jobs + i, _job_text + _jobs[i].text_offset);
+    _n_jobs = 0;
+    _n_job_cells = 0;
+}
+
+/* Returns FALSE if the job couldn't be queued (out of memory),  in which
+case the caller draws it right away. */
+
+static bool _queue_job( const struct raster_job *job, const chtype *text)
+{
+    if( _n_jobs == _n_jobs_alloced)
+    {
+        const int new_size = _n_jobs_alloced * 2 + 256;
+        struct raster_job *new_jobs = (struct raster_job *)realloc( _jobs,
+                                      new_size * sizeof( struct raster_job));
+
+        if( !new_jobs)
+            return( FALSE);
+        _jobs = new_jobs;
+        _n_jobs_alloced = new_size;
+    }
+    if( _n_job_cells + job->len > _n_job_cells_alloced)
+    {
+        const size_t new_size = _n_job_cells_alloced * 2 + job->len + 4096;
+        chtype *new_text = (chtype *)realloc( _job_text,
+                                      new_size * sizeof( chtype));
+
+        if( !new_text)
+            return( FALSE);
+        _job_text = new_text;
+        _n_job_cells_alloced = new_size;
+    }
+    _jobs[_n_jobs] = *job;
+    _jobs[_n_jobs++].text_offset = _n_job_cells;
+    memcpy( _job_text + _n_job_cells, text, job->len * sizeof( chtype));
+    _n_job_cells += job->len;
+    return( TRUE);
+}
+
+void PDC_free_raster_threads( void)
+{
+    int i;
+
+    pthread_mutex_lock( &_pool_mutex);
+    _quit_workers = TRUE;
+    pthread_cond_broadcast( &_work_ready);
+    pthread_mutex_unlock( &_pool_mutex);
+    for( i = 0; i < _n_workers; i++)
+        pthread_join( _workers[i], NULL);
+    _n_workers = 0;
+    _quit_workers = FALSE;
+    free( _jobs);
+    free( _job_text);
+    free( _row_cells);
+    _jobs = NULL;
+    _job_text = NULL;
+    _row_cells = NULL;
+    _n_jobs = _n_jobs_alloced = _n_row_cells_alloced = 0;
+    _n_job_cells = _n_job_cells_alloced = 0;
+}
+
+void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
+{
+    int cursor_to_draw = 0;
+    int stride;
+    const uint32_t *rgb_row = PDC_rgb_plane( curscr, &stride, FALSE);
+
     assert( srcp);
     assert( x >= 0);
     assert( len <= SP->cols - x);
@@ -352,6 +1135,9 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
         if( len <= 0)
             return;
     }
+    _init_glyph_masks( );
+    _add_damage( x * PDC_font_info.width, lineno * PDC_font_info.height,
+                 len * PDC_font_info.width, PDC_font_info.height);
     if( lineno == SP->cursrow && x <= SP->curscol && x + len > SP->curscol)
     {
         cursor_to_draw = (PDC_blink_state ? SP->visibility & 0xff : (SP->visibility >> 8));
@@ -369,18 +1155,16 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
     }
     while( len)
     {
+        struct raster_job job;
         int run_len = 0;
         PACKED_RGB fg, bg;
-        const long video_offset = x * PDC_font_info.width
-                     + lineno * PDC_font_info.height * line_len;
 
-        PDC_get_rgb_values( *srcp & ~A_REVERSE, &fg, &bg);
+        PDC_get_cell_rgb_values( *srcp & ~A_REVERSE,
+                    (rgb_row ? rgb_row + lineno * stride + x * 2 : NULL), &fg, &bg);
         if( fg == (PACKED_RGB)-1)   /* default foreground */
             fg = 0xffffff;
-        fg = SWAP_RED_AND_BLUE( fg);
         if( bg == (PACKED_RGB)-1)   /* default background */
             bg = 0;
-        bg = SWAP_RED_AND_BLUE( bg);
         if( *srcp & A_REVERSE)
         {
             PACKED_RGB temp_rgb = fg;
@@ -388,38 +1172,19 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
             fg = bg;
             bg = temp_rgb;
         }
-        while( run_len < len && !((*srcp ^ srcp[run_len]) & A_ATTRIBUTES))
+        if( *srcp & PDC_RGB_CELL)     /* each RGB cell has its own colors */
+            run_len = 1;
+        else while( run_len < len
+                  && !((*srcp ^ srcp[run_len]) & (A_ATTRIBUTES | PDC_RGB_CELL)))
             run_len++;
-        if( PDC_fb.bits_per_pixel == 32)
+        if( PDC_fb.bits_per_pixel > 8)
         {
-            int i;
-            uint32_t *tptr = (uint32_t *)PDC_fb.framebuf + video_offset;
-
-            for( i = 0; i < run_len; i++)
-            {
-                const uint8_t *fontptr = _get_glyph( *srcp, cursor_to_draw, scratch);
-                uint32_t *fb_ptr = tptr;
-                int i, j;
-
-                for( i = 0; i < (int)PDC_font_info.height; i++)
-                {
-                    for( j = 0; j < (int)PDC_font_info.width; j++)
-                        *fb_ptr++ = ((fontptr[j >> 3] << (j & 7)) & 0x80) ? fg : bg;
-                    fb_ptr += line_len - PDC_font_info.width;
-                    fontptr += font_char_size_in_bytes;
-                }
-                srcp++;
-                len--;
-                tptr += PDC_font_info.width;
-                x++;
-            }
+            job.fg = _pack_rgb( fg);
+            job.bg = _pack_rgb( bg);
         }
-        if( PDC_fb.bits_per_pixel == 8)
+        else        /* 8 bits/pixel,  palette indices */
         {
-            const int line_len = PDC_fb.line_length; /* / sizeof( uint8_t); */
-            int i, integer_fg_idx, integer_bg_idx;
-            uint8_t fg_idx, bg_idx;
-            uint8_t *tptr = (uint8_t *)PDC_fb.framebuf + video_offset;
+            int integer_fg_idx, integer_bg_idx;
             bool reverse_colors = ((*srcp & A_REVERSE) ? TRUE : FALSE);
 
             extended_pair_content( (*srcp & A_COLOR) >> PDC_COLOR_SHIFT,
@@ -439,30 +1204,139 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
                 integer_fg_idx = integer_bg_idx;
                 integer_bg_idx = swapval;
             }
-            fg_idx = (uint8_t)integer_fg_idx;
-            bg_idx = (uint8_t)integer_bg_idx;
-            for( i = 0; i < run_len; i++)
-            {
-                const uint8_t *fontptr = _get_glyph( *srcp, cursor_to_draw, scratch);
-                uint8_t *fb_ptr = tptr;
-                int i, j;
-
-                for( i = 0; i < (int)PDC_font_info.height; i++)
-                {
-                    for( j = 0; j < (int)PDC_font_info.width; j++)
-                        *fb_ptr++ = ((fontptr[j >> 3] << (j & 7)) & 0x80) ? fg_idx : bg_idx;
-                    fb_ptr += line_len - PDC_font_info.width;
-                    fontptr += font_char_size_in_bytes;
-                }
-                srcp++;
-                len--;
-                tptr += PDC_font_info.width;
-                x++;
-            }
+            job.fg = (uint8_t)integer_fg_idx;
+            job.bg = (uint8_t)integer_bg_idx;
+        }
+        job.lineno = lineno;
+        job.x = x;
+        job.len = run_len;
+        job.cursor_type = cursor_to_draw;
+        if( _n_threads < 2 || !_queue_job( &job, srcp))
+        {
+            _run_raster_jobs( );     /* keep queued jobs ahead of this one */
+            _draw_job( _contexts, &job, srcp);
         }
+        srcp += run_len;
+        x += run_len;
+        len -= run_len;
+    }
+}
+
+/* Copies pixels x1 up to (but not including) x2 of pixel row y from the
+shadow buffer to video memory,  widened to 16-byte boundaries. */
+
+static void _copy_span_to_video( const int y, const int x1, const int x2)
+{
+    const long row_offset = (long)y * PDC_fb.line_length;
+    long start = (long)x1 * PDC_fb.bits_per_pixel / 8;
+    long end = ((long)x2 * PDC_fb.bits_per_pixel + 7) / 8;
+
+    start &= ~15L;
+    end = (end + 15) & ~15L;
+    if( end > (long)PDC_fb.line_length)
+        end = (long)PDC_fb.line_length;
+    _copy_to_video( (uint8_t *)PDC_fb.video_mem + row_offset + start,
+               (const uint8_t *)PDC_fb.framebuf + row_offset + start,
+               (size_t)( end - start));
+}
+
+/* Pushes a single character cell to video memory (and,  on DRM,  reports
+it as dirty),  leaving the rest of the damage for PDC_doupdate( ).  The
+cell's damage isn't removed;  it'll just be copied again at that point. */
+
+static void _flush_cell( const int row, const int col)
+{
+    const int x1 = col * PDC_font_info.width;
+    const int y1 = row * PDC_font_info.height;
+    int x2 = x1 + PDC_font_info.width;
+    int y2 = y1 + PDC_font_info.height;
+    int y;
+
+    if( x2 > (int)PDC_fb.xres)
+        x2 = (int)PDC_fb.xres;
+    if( y2 > (int)PDC_fb.yres)
+        y2 = (int)PDC_fb.yres;
+    if( x1 >= x2 || y1 >= y2)
+        return;
+    _run_raster_jobs( );
+    if( PDC_fb.framebuf != PDC_fb.video_mem)
+    {
+        for( y = y1; y < y2; y++)
+            _copy_span_to_video( y, x1, x2);
+#ifdef __SSE2__
+        _mm_sfence( );
+#endif
     }
+#ifdef USE_DRM
+    {
+        int rect[4];
+
+        rect[0] = x1;
+        rect[1] = y1;
+        rect[2] = x2;
+        rect[3] = y2;
+        PDC_drm_dirty( rect, 1);
+    }
+#endif
 }
 
+/* Copies damaged spans from the shadow buffer (if any) to video memory.
+Spans are widened to 16-byte boundaries,  so the copies are done with
+full-width aligned stores.  On DRM,  runs of consecutive damaged rows are
+then reported to the driver as dirty rectangles;  some drivers (virtual
+GPUs,  USB displays,  etc.) won't show anything otherwise.  */
+
 void PDC_doupdate(void)
 {
+    const bool shadowed = (PDC_fb.framebuf != PDC_fb.video_mem);
+    int y;
+#ifdef USE_DRM
+    int rects[PDC_MAX_DIRTY_RECTS * 4], n_rects = 0;
+#endif
+
+    _run_raster_jobs( );
+    if( !_damage_x1 || _damage_y1 >= _damage_y2)
+        return;
+    for( y = _damage_y1; y < _damage_y2; y++)
+        if( _damage_x1[y] < _damage_x2[y])
+        {
+            if( shadowed)
+                _copy_span_to_video( y, _damage_x1[y], _damage_x2[y]);
+#ifdef USE_DRM
+            {
+                int *rect;
+
+                          /* start a new rectangle if this row isn't */
+                          /* adjacent to the previous one,  unless we've */
+                          /* run out,  in which case the last one grows */
+                if( !n_rects || (rects[n_rects * 4 - 1] != y
+                                 && n_rects < PDC_MAX_DIRTY_RECTS))
+                {
+                    rect = rects + n_rects * 4;
+                    n_rects++;
+                    rect[0] = _damage_x1[y];
+                    rect[1] = y;
+                    rect[2] = _damage_x2[y];
+                }
+                else
+                    rect = rects + (n_rects - 1) * 4;
+                if( rect[0] > _damage_x1[y])
+                    rect[0] = _damage_x1[y];
+                if( rect[2] < _damage_x2[y])
+                    rect[2] = _damage_x2[y];
+                rect[3] = y + 1;
+            }
+#endif
+            _damage_x1[y] = (int)PDC_fb.xres;
+            _damage_x2[y] = 0;
+        }
+#ifdef __SSE2__
+    if( shadowed)
+        _mm_sfence( );
+#endif
+    _damage_y1 = (int)PDC_fb.yres;
+    _damage_y2 = 0;
+#ifdef USE_DRM
+    PDC_drm_dirty( rects, n_rects);
+#endif
 }
@@ -8,11 +8,38 @@
 #endif
 
 void PDC_puts_to_stdout( const char *buff);        /* pdcdisp.c */
+void PDC_free_glyph_masks( void);                  /* pdcdisp.c */
+int PDC_init_shadow_buffer( void);                 /* pdcdisp.c */
+void PDC_free_shadow_buffer( void);                /* pdcdisp.c */
+int PDC_set_pixel_format( void);                   /* pdcdisp.c */
+void PDC_init_raster_threads( void);               /* pdcdisp.c */
+void PDC_free_raster_threads( void);               /* pdcdisp.c */
+#ifdef USE_DRM
+#define PDC_MAX_DIRTY_RECTS 16
+void PDC_drm_dirty( const int *rects, const int n_rects);   /* drm.c */
+#endif
+
+/* 'framebuf' is what all drawing goes to.  Normally,  that's a shadow
+buffer in system RAM,  copied to the actual video memory ('video_mem')
+in PDC_doupdate( ).  With PDC_FB_SHADOW=N in the environment,  there's
+no shadow buffer and 'framebuf' == 'video_mem'.  */
+
+/* Where each color component goes within a pixel,  as given by the
+red/green/blue bitfields of FBIOGET_VSCREENINFO.  Used for 16,  24,  and
+32 bit displays;  8-bit displays use a palette.  If all are left zero
+(as they are for DRM),  PDC_set_pixel_format( ) fills in the usual
+RGB565 or XRGB8888 layout.  */
+
+struct pixel_field
+{
+   unsigned offset, length;
+};
 
 struct video_info
 {
-   void *framebuf;
+   void *framebuf, *video_mem;
    unsigned xres, yres, bits_per_pixel;
+   struct pixel_field red, green, blue;
    unsigned line_length;
    unsigned smem_len;
 };
@@ -6,6 +6,7 @@
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include "pdcfb.h"
 #include "psf.c"
@@ -102,20 +103,18 @@ void PDC_save_screen_mode(int i)
 
 bool PDC_has_rgb_color = TRUE;
 struct font_info PDC_font_info;
-static uint8_t *_loaded_font_bytes;
+static void *_font_map;          /* mmap()ed PDC_FONTn file,  if any */
+static size_t _font_map_size;
 
 static void _unload_font( void)
 {
-   if( _loaded_font_bytes)
+   PDC_free_glyph_masks( );
+   if( _font_map)
    {
-      free( _loaded_font_bytes);
-      _loaded_font_bytes = NULL;
-   }
-   if( PDC_font_info.unicode_info)
-   {
-      free( PDC_font_info.unicode_info);
-      PDC_font_info.unicode_info = NULL;
+      munmap( _font_map, _font_map_size);
+      _font_map = NULL;
    }
+   free_psf_or_vgafont( &PDC_font_info);
 }
 
 #ifndef USE_DRM
@@ -130,10 +129,13 @@ void PDC_scr_close( void)
    tcsetattr( STDIN, TCSANOW, &orig_term);
    PDC_doupdate( );
    PDC_puts_to_stdout( NULL);      /* free internal cache */
+   PDC_free_raster_threads( );
 #ifdef USE_DRM
+   PDC_free_shadow_buffer( );
    close_drm( );
 #else
-   munmap( PDC_fb.framebuf, PDC_fb.smem_len);
+   PDC_free_shadow_buffer( );
+   munmap( PDC_fb.video_mem, PDC_fb.smem_len);
    close( _framebuffer_fd);
 #endif
    _unload_font( );
@@ -190,31 +192,31 @@ static int _load_psf_font( const int font_num)
         font_filename = getenv( env_var);
         if( font_filename)
         {
-            FILE *font_fp = fopen( font_filename, "rb");
+            const int font_fd = open( font_filename, O_RDONLY);
+            struct stat st;
 
-            if( font_fp)
+                    /* The glyphs are used straight from the mapped file, */
+                    /* which stays mapped until the font is unloaded.     */
+            if( font_fd >= 0)
             {
-                uint8_t *buff;
-                long n_bytes;
-
-                fseek( font_fp, 0L, SEEK_END);
-                n_bytes = ftell( font_fp);
-                fseek( font_fp, 0L, SEEK_SET);
-                buff = (uint8_t *)malloc( n_bytes + 1);
-                buff[n_bytes] = '\0';
-                if( fread( buff, 1, n_bytes, font_fp) != (size_t)n_bytes)
-                    return( -5);
-                fclose( font_fp);
-                if( !load_psf_or_vgafont( &PDC_font_info, buff, n_bytes))
+                if( !fstat( font_fd, &st) && st.st_size > 4)
                 {
-                    uint32_t glyph_buff_size = PDC_font_info.n_glyphs * PDC_font_info.charsize;
-
-                    _loaded_font_bytes = (uint8_t *)malloc( glyph_buff_size);
-
-                    memcpy( _loaded_font_bytes, PDC_font_info.glyphs, glyph_buff_size);
-                    PDC_font_info.glyphs = _loaded_font_bytes;
+                    void *map = mmap( NULL, (size_t)st.st_size, PROT_READ,
+                                      MAP_PRIVATE, font_fd, 0);
+
+                    if( map != MAP_FAILED)
+                    {
+                        if( !load_psf_or_vgafont( &PDC_font_info,
+                                      (const uint8_t *)map, (long)st.st_size))
+                        {
+                            _font_map = map;
+                            _font_map_size = (size_t)st.st_size;
+                        }
+                        else
+                            munmap( map, (size_t)st.st_size);
+                    }
                 }
-                free( buff);
+                close( font_fd);
             }
         }
     }
@@ -223,9 +225,12 @@ static int _load_psf_font( const int font_num)
             /* If there's no Unicode info,  the font is probably a CP437 one. */
             /* We can use the data in uni_info.h to make the translations. */
     if( !PDC_font_info.unicode_info)
+    {
        PDC_font_info.unicode_info =  _decipher_psf2_unicode_table(
                font_bytes + UNICODE_INFO_OFFSET, UNICODE_INFO_SIZE,
                &PDC_font_info.unicode_info_size);
+       build_psf_glyph_index( &PDC_font_info);
+    }
 #endif
     if( PDC_font_info.glyphs)
     {
@@ -302,14 +307,29 @@ int PDC_scr_open(void)
     PDC_fb.xres = PDC_vinfo.xres;
     PDC_fb.yres = PDC_vinfo.yres;
     PDC_fb.bits_per_pixel = PDC_vinfo.bits_per_pixel;
+    PDC_fb.red.offset = PDC_vinfo.red.offset;
+    PDC_fb.red.length = PDC_vinfo.red.length;
+    PDC_fb.green.offset = PDC_vinfo.green.offset;
+    PDC_fb.green.length = PDC_vinfo.green.length;
+    PDC_fb.blue.offset = PDC_vinfo.blue.offset;
+    PDC_fb.blue.length = PDC_vinfo.blue.length;
     PDC_fb.line_length = PDC_finfo.line_length;
     PDC_fb.smem_len = PDC_finfo.smem_len;
-    PDC_fb.framebuf = mmap(NULL, PDC_finfo.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+    PDC_fb.video_mem = mmap(NULL, PDC_finfo.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED,
                   _framebuffer_fd, 0);
-    if( PDC_fb.framebuf == MAP_FAILED)
+    if( PDC_fb.video_mem == MAP_FAILED)
         return( -4);
 
 #endif
+    if( PDC_set_pixel_format( ))
+    {
+        fprintf( stderr, "%u bits/pixel displays aren't supported\n",
+                    PDC_fb.bits_per_pixel);
+        return( -6);
+    }
+    if( PDC_init_shadow_buffer( ))
+        return( -5);
+    PDC_init_raster_threads( );
     PDC_has_rgb_color = (PDC_fb.bits_per_pixel > 8);
     if( PDC_has_rgb_color)
        COLORS = 256 + (256 * 256 * 256);
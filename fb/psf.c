@@ -12,9 +12,10 @@ https://www.win.tue.nl/~aeb/linux/kbd/font-formats-1.html
    and for the (much simpler) 'vgafont' font format;  see _load_vgafont()
 below. The PSF fonts can contain Unicode information,  a table basically
 saying "Unicode point x corresponds to glyph y".  This code reads that
-information (if it's provided) and sorts it by Unicode point,  so that
-when the glyph for a given Unicode point is desired,  we can
-binary-search for it. */
+information (if it's provided) and sorts it by Unicode point.  From
+that,  build_psf_glyph_index() makes a table giving the glyph for each
+Basic Multilingual Plane point,  plus a small hash table for any points
+beyond that,  so finding a glyph doesn't need a binary search.  */
 
 
 #define PSF1_MAGIC0     0x36
@@ -46,9 +47,13 @@ static int _load_psf1( struct font_info *f, const uint8_t *buff, const long file
    struct psf1_header hdr;
    int n_references_found = 0;
 
-   if( buff[0] != PSF1_MAGIC0 && buff[1] != PSF1_MAGIC1)
+   if( filelen < (long)sizeof( hdr)
+            || buff[0] != PSF1_MAGIC0 || buff[1] != PSF1_MAGIC1)
       return( -1);
    memcpy( &hdr, buff, sizeof( hdr));
+   if( filelen < 4 + ((hdr.mode & PSF1_MODE512) ? 512 : 256) * (long)hdr.charsize)
+      return( -1);                 /* truncated glyph data */
+   free_psf_or_vgafont( f);
    f->font_type = 1;
    f->n_glyphs = ((hdr.mode & PSF1_MODE512) ? 512 : 256);
    f->headersize = 4;
@@ -59,11 +64,13 @@ static int _load_psf1( struct font_info *f, const uint8_t *buff, const long file
       {
       size_t i = (size_t) 4 + f->n_glyphs * hdr.charsize;
       unsigned glyph_num = 0;
-      unsigned max_info_size = (unsigned)( (filelen - i) / 2 - f->n_glyphs);
-      uint32_t *tptr = (uint32_t *)malloc( max_info_size * 2 * sizeof( uint32_t));
+      const unsigned max_info_size = (unsigned)( (filelen - i) / 2);
+      uint32_t *tptr = (uint32_t *)malloc( (max_info_size + 1) * 2 * sizeof( uint32_t));
 
       f->unicode_info = tptr;
-      for( ; i < (size_t)filelen; i += 2)
+      if( !tptr)
+         i = (size_t)filelen;     /* out of memory:  no Unicode info */
+      for( ; i + 1 < (size_t)filelen; i += 2)    /* odd last byte ignored */
          {
          const unsigned ival = buff[i] | ((unsigned)buff[i + 1] << 8);
 
@@ -83,6 +90,7 @@ static int _load_psf1( struct font_info *f, const uint8_t *buff, const long file
    else
       f->unicode_info = NULL;
    f->unicode_info_size = n_references_found;
+   build_psf_glyph_index( f);
    return( 0);
 }
 
@@ -125,31 +133,38 @@ static uint32_t *_decipher_psf2_unicode_table( const uint8_t *buff, const size_t
    for( i = 0; i < info_len; i++)
       if( IS_UTF8_STARTING_BYTE( buff[i]))
          n1++;
-   unicode_info = tptr = (uint32_t *)malloc( n1 * 2 * sizeof( uint32_t));
+   unicode_info = tptr = (uint32_t *)malloc( (n1 + 1) * 2 * sizeof( uint32_t));
+   if( !unicode_info)
+      {
+      *unicode_info_size = 0;
+      return( NULL);
+      }
+            /* Stray continuation bytes are skipped,  and a sequence cut */
+            /* off by the end of the table ends it;  either way,  we never */
+            /* read past info_len,  nor store more than n1 references.    */
    for( i = 0; i < info_len; i++)
       if( buff[i] == PSF2_SEPARATOR)
          glyph_num++;
-      else if( buff[i] != PSF2_STARTSEQ)
+      else if( buff[i] != PSF2_STARTSEQ && IS_UTF8_STARTING_BYTE( buff[i]))
          {
          unsigned cval;    /* decipher UTF8 value */
+         const size_t n_bytes = (!(buff[i] & 0x80) ? 1 :
+                                 (buff[i] & 0xe0) == 0xc0 ? 2 :
+                                 (buff[i] & 0xf0) == 0xe0 ? 3 : 4);
 
-         if( !(buff[i] & 0x80))           /* plain ASCII */
+         if( i + n_bytes > info_len)
+            break;
+         if( n_bytes == 1)                 /* plain ASCII */
             cval = (unsigned)buff[i];
-         else if( (buff[i] & 0xe0) == 0xc0) /* two-byte UTF8 : code */
-            {                               /* points U+80 to U+7FF */
+         else if( n_bytes == 2)            /* two-byte UTF8 : code */
             cval = ((buff[i] & 0x1f) << 6) | (buff[i + 1] & 0x3f);
-            i++;
-            }
          else
             {           /* three-byte UTF: U+800 to U+FFFF */
             cval = ((buff[i] & 0x0f) << 12) | ((buff[i + 1] & 0x3f) << 6) | (buff[i + 2] & 0x3f);
-            if( (buff[i] & 0xf0) == 0xf0)     /* Four-byte UTF:  */
-               {                              /* U+10000 and beyond (SMP) */
+            if( n_bytes == 4)     /* Four-byte UTF:  U+10000 and beyond (SMP) */
                cval = (cval << 6) | (buff[i + 3] & 0x3f);
-               i++;
-               }
-            i += 2;
             }
+         i += n_bytes - 1;
          *tptr++ = cval;
          *tptr++ = glyph_num;
          n_references_found++;
@@ -165,10 +180,15 @@ static int _load_psf2( struct font_info *f, const uint8_t *buff, const long file
 {
    struct psf2_header hdr;
 
-   if( buff[0] != PSF2_MAGIC0 || buff[1] != PSF2_MAGIC1
+   if( filelen < (long)sizeof( hdr) || buff[0] != PSF2_MAGIC0
+            || buff[1] != PSF2_MAGIC1
             || buff[2] != PSF2_MAGIC2 || buff[3] != PSF2_MAGIC3)
       return( -1);
    memcpy( &hdr, buff, sizeof( hdr));
+   if( hdr.headersize > (uint32_t)filelen || !hdr.charsize
+            || hdr.length > ((uint32_t)filelen - hdr.headersize) / hdr.charsize)
+      return( -1);                 /* truncated glyph data */
+   free_psf_or_vgafont( f);
    f->font_type = 2;
    f->n_glyphs = hdr.length;
    f->headersize = hdr.headersize;
@@ -188,6 +208,7 @@ static int _load_psf2( struct font_info *f, const uint8_t *buff, const long file
       f->unicode_info = NULL;
       f->unicode_info_size = 0;
       }
+   build_psf_glyph_index( f);
    return( 0);
 }
 
@@ -205,8 +226,7 @@ static int _load_vgafont( struct font_info *f, const uint8_t *buff, const long f
       return( -1);
    else
       {
-      f->unicode_info = NULL;
-      f->unicode_info_size = 0;
+      free_psf_or_vgafont( f);
       f->font_type = 0;
       f->n_glyphs = 256;
       f->headersize = 0;
@@ -226,11 +246,114 @@ int load_psf_or_vgafont( struct font_info *f, const uint8_t *buff, const long fi
       return( 0);
 }
 
+/* The BMP index has 64K entries,  NO_GLYPH for points the font lacks.
+Points past U+FFFF are rare in console fonts;  they go in an
+open-addressed hash table of (code point, glyph) pairs,  at most half
+full,  with a zero code point marking an empty slot.  If the font has
+too many glyphs for 16-bit indices,  or we're out of memory,  there's
+no index and we fall back to a binary search of 'unicode_info'.  */
+
+#define NO_GLYPH 0xffff
+
+static uint32_t _astral_slot( const uint32_t unicode_point, const uint32_t bits)
+{
+   return( (unicode_point * 2654435761u) >> (32 - bits));
+}
+
+void build_psf_glyph_index( struct font_info *f)
+{
+   uint32_t i, n_astral = 0;
+
+   free( f->bmp_index);
+   free( f->astral_hash);
+   f->bmp_index = NULL;
+   f->astral_hash = NULL;
+   f->astral_hash_bits = 0;
+   if( !f->unicode_info || f->n_glyphs >= NO_GLYPH)
+      return;
+   f->bmp_index = (uint16_t *)malloc( 0x10000 * sizeof( uint16_t));
+   if( !f->bmp_index)
+      return;
+   memset( f->bmp_index, 0xff, 0x10000 * sizeof( uint16_t));
+   for( i = 0; i < f->unicode_info_size; i++)
+      {
+      const uint32_t unicode_point = f->unicode_info[i * 2];
+
+      if( unicode_point >= 0x10000)
+         n_astral++;
+      else if( f->bmp_index[unicode_point] == NO_GLYPH)
+         f->bmp_index[unicode_point] = (uint16_t)f->unicode_info[i * 2 + 1];
+      }
+   if( n_astral)
+      {
+      const uint32_t *tptr = f->unicode_info + 2 * (f->unicode_info_size - n_astral);
+      uint32_t bits = 2, mask;
+
+      while( (1u << bits) < n_astral * 2)
+         bits++;
+      mask = (1u << bits) - 1;
+      f->astral_hash = (uint32_t *)calloc( (size_t)2 << bits, sizeof( uint32_t));
+      if( !f->astral_hash)
+         {
+         free( f->bmp_index);
+         f->bmp_index = NULL;
+         return;
+         }
+      f->astral_hash_bits = bits;
+      for( i = 0; i < n_astral; i++, tptr += 2)
+         {
+         uint32_t slot = _astral_slot( tptr[0], bits);
+
+         while( f->astral_hash[slot * 2] && f->astral_hash[slot * 2] != tptr[0])
+            slot = (slot + 1) & mask;
+         if( !f->astral_hash[slot * 2])
+            {
+            f->astral_hash[slot * 2] = tptr[0];
+            f->astral_hash[slot * 2 + 1] = tptr[1];
+            }
+         }
+      }
+}
+
+void free_psf_or_vgafont( struct font_info *f)
+{
+   free( f->unicode_info);
+   free( f->bmp_index);
+   free( f->astral_hash);
+   f->unicode_info = NULL;
+   f->bmp_index = NULL;
+   f->astral_hash = NULL;
+   f->unicode_info_size = f->astral_hash_bits = 0;
+}
+
 int find_psf_or_vgafont_glyph( struct font_info *f, const uint32_t unicode_point)
 {
    int rval = -1;
 
-   if( f->unicode_info)
+   if( f->bmp_index)
+      {
+      if( unicode_point < 0x10000)
+         {
+         if( f->bmp_index[unicode_point] != NO_GLYPH)
+            rval = (int)f->bmp_index[unicode_point];
+         }
+      else if( f->astral_hash)
+         {
+         const uint32_t mask = (1u << f->astral_hash_bits) - 1;
+         uint32_t slot = _astral_slot( unicode_point, f->astral_hash_bits);
+
+         while( f->astral_hash[slot * 2])
+            {
+            if( f->astral_hash[slot * 2] == unicode_point)
+               {
+               rval = (int)f->astral_hash[slot * 2 + 1];
+               break;
+               }
+            slot = (slot + 1) & mask;
+            }
+         }
+      }
+   else if( f->unicode_info)
       {
       const uint32_t *tptr = (const uint32_t *)bsearch( &unicode_point, f->unicode_info,
                   f->unicode_info_size, 2 * sizeof( uint32_t), _compare_unicode_info);
@@ -6,8 +6,13 @@ struct font_info {
         uint32_t height, width; /* max dimensions of glyphs */
         uint32_t *unicode_info;
         uint32_t unicode_info_size;
+        uint16_t *bmp_index;    /* glyph for each BMP code point;  see psf.c */
+        uint32_t *astral_hash;  /* (code point, glyph) pairs for the rest */
+        uint32_t astral_hash_bits;
         const uint8_t *glyphs;
 };
 
 int load_psf_or_vgafont( struct font_info *f, const uint8_t *buff, const long filelen);
 int find_psf_or_vgafont_glyph( struct font_info *f, const uint32_t unicode_point);
+void build_psf_glyph_index( struct font_info *f);
+void free_psf_or_vgafont( struct font_info *f);
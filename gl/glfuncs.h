@@ -49,6 +49,7 @@
 #define glClearBufferfv pdc_glClearBufferfv
 #define glUseProgram pdc_glUseProgram
 #define glBufferData pdc_glBufferData
+#define glBufferSubData pdc_glBufferSubData
 #define glDrawArraysInstanced pdc_glDrawArraysInstanced
 #define glBlitFramebuffer pdc_glBlitFramebuffer
 #define glClear pdc_glClear
@@ -107,6 +108,7 @@
     GLFUNC(CLEARBUFFERFV, ClearBufferfv) \
     GLFUNC(USEPROGRAM, UseProgram) \
     GLFUNC(BUFFERDATA, BufferData) \
+    GLFUNC(BUFFERSUBDATA, BufferSubData) \
     GLFUNC(DRAWARRAYSINSTANCED, DrawArraysInstanced) \
     GLFUNC(BLITFRAMEBUFFER, BlitFramebuffer) \
     GLFUNCPROTO(CLEAR, Clear, (GLbitfield)) \
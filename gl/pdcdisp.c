@@ -53,32 +53,28 @@ struct glyph_grid_layer
      */
     Uint32 occupancy;
 
-    /* The glyph info format is as below:
-     *  0-14: character x offset in glyph cache
-     * 15-29: character y offset in glyph cache
-     * 30-31: Width; 0 = empty, 1 = normal, 2 = fullwidth.
-     *
-     * See also: BUILD_GLYPH_INDEX
-     */
-    Uint32* glyph_grid;
-
-    /* The codepoints are temporarily stored here, as the 'grid' array is only
-     * updated when rendering.
+    /* The codepoints are stored here; they're only turned into glyph cache
+     * indices on the render side (see 'render_glyph_grids' below).
      * 0-30: Unicode code point
      * 30-31: attribute index
      */
     Uint32* codepoint_attr;
 };
 
-/* The `glyph_grid` members from `glyph_grid_layers` are only used in 
- * single-threaded mode; multithreaded mode instead builds them in the render
- * states below.
- */
 static struct glyph_grid_layer* glyph_grid_layers = NULL;
 static int grid_w = 0, grid_h = 0, grid_layers = 0;
 static int cur_render_target_w = 0, cur_render_target_h = 0;
 static int cache_attr_index = 0; /* Value range is 0 to 3 */
 
+/* Each grid row holds the value 'current_version' had when draw_glyph() or
+ * draw_cursor() last touched it. Copies of the grid (the render states below)
+ * remember the versions of the rows they hold, so bringing one up to date only
+ * takes copying the rows whose versions differ. The render side compares them
+ * the same way to find the rows it has to resolve and upload again.
+ */
+static Uint32* row_versions = NULL;
+static Uint32 current_version = 1;
+
 /* All dynamically changing state required for rendering is duplicated in this
  * structure for multithreading. This avoids race conditions, as the glyph grid
  * layers can be updated while the duplicate is used for rendering.
@@ -89,6 +85,9 @@ struct mt_render_state
     struct glyph_grid_layer* glyph_grid_layers;
     int grid_w, grid_h, grid_layers;
 
+    /* The version of each row held here; see 'row_versions'. */
+    Uint32* row_versions;
+
     SDL_Rect viewport;
     int hcol;
     PACKED_RGB hcol_rgb;
@@ -96,20 +95,61 @@ struct mt_render_state
     int updated;
 };
 
-/* When preparing to render a new frame, its data is put into submitted_state
- * and its 'updated' is set to 1. This signals the rendering thread that it can
- * copy that data over to 'locked_state' and keep reading from that. This
- * approach makes it so that 'submitted_state' is not locked for the whole
- * rendering duration, but only for the amount of time needed to swap
- * submitted_state and locked_state around.
+/* The states are triple-buffered. A new frame is prepared in filling_state,
+ * which only the main thread touches, so that only the rows that changed since
+ * that copy was last filled need copying, and that happens outside the lock.
+ * It is then swapped with submitted_state, whose 'updated' is set to 1. This
+ * signals the rendering thread that it can swap submitted_state with
+ * 'locked_state' and keep reading from that. This way 'pdc_render_mutex' is
+ * only held for the time needed to swap two structures around, however large
+ * the grid is.
  */
+static struct mt_render_state filling_state = {
+    NULL, NULL, 0, 0, 0, NULL, {0, 0, 0, 0}, 0, 0, 0
+};
 static struct mt_render_state submitted_state = {
-    NULL, NULL, 0, 0, 0, {0, 0, 0, 0}, 0, 0
+    NULL, NULL, 0, 0, 0, NULL, {0, 0, 0, 0}, 0, 0, 0
 };
 static struct mt_render_state locked_state = {
-    NULL, NULL, 0, 0, 0, {0, 0, 0, 0}, 0, 0
+    NULL, NULL, 0, 0, 0, NULL, {0, 0, 0, 0}, 0, 0, 0
 };
 
+/* The render side keeps the glyph cache indices of every layer around between
+ * frames, so that only dirty rows need to go through get_glyph_texture_index()
+ * again. The format is as below:
+ *  0-14: character x offset in glyph cache
+ * 15-29: character y offset in glyph cache
+ * 30-31: Width; 0 = empty, 1 = normal, 2 = fullwidth.
+ *
+ * See also: BUILD_GLYPH_INDEX
+ */
+static Uint32** render_glyph_grids = NULL;
+static int render_grid_w = 0, render_grid_h = 0, render_grid_layers = 0;
+
+/* The row versions of the last rendered frame, and the rows of the current one
+ * that differ from them.
+ */
+static Uint32* rendered_versions = NULL;
+static Uint8* render_dirty_rows = NULL;
+
+/* pdc_glyph_buffer is shared by all layers; this is the layer whose glyphs it
+ * currently holds, or -1 if it doesn't hold a complete one.
+ */
+static int glyph_buffer_layer = -1;
+
+/* Set when glyph cache eviction has moved glyphs around, which rewrites
+ * indices all over 'render_glyph_grids'.
+ */
+static bool upload_all_rows = FALSE;
+
+/* Marks every row as changed, for when the grid layout itself changes. */
+static void touch_all_rows(void)
+{
+    int row;
+    for(row = 0; row < grid_h; ++row)
+        row_versions[row] = current_version;
+}
+
 static int next_pow_2(int n)
 {
     n--;
@@ -214,10 +254,8 @@ static void enlarge_glyph_cache()
     }
     else
     {
-        bool* visited = calloc(
-            locked_state.grid_w * locked_state.grid_h * locked_state.grid_layers,
-            sizeof(bool)
-        );
+        const int cells = render_grid_w * render_grid_h;
+        bool* visited = calloc(cells * render_grid_layers, sizeof(bool));
         int attr;
 
         /* If we're here, it's not possible to enlarge the texture, so we have
@@ -239,12 +277,12 @@ static void enlarge_glyph_cache()
                 continue;
 
             /* Check if glyph is used in any layer */
-            for(layer = 0; layer < locked_state.grid_layers; ++layer)
-            for(j = 0; j < locked_state.grid_w * locked_state.grid_h; ++j)
+            for(layer = 0; layer < render_grid_layers; ++layer)
+            for(j = 0; j < cells; ++j)
             {
                 if(
-                    locked_state.glyph_grid_layers[layer].glyph_grid[j] == old_glyph &&
-                    !visited[j + layer * locked_state.grid_w * locked_state.grid_h]
+                    render_glyph_grids[layer][j] == old_glyph &&
+                    !visited[j + layer * cells]
                 ){
                     used = TRUE;
                     break;
@@ -279,20 +317,23 @@ static void enlarge_glyph_cache()
             }
 
             /* Update existing uses of the updated glyph */
-            for(layer = 0; layer < locked_state.grid_layers; ++layer)
-            for(j = 0; j < locked_state.grid_w * locked_state.grid_h; ++j)
+            for(layer = 0; layer < render_grid_layers; ++layer)
+            for(j = 0; j < cells; ++j)
             {
                 if(
-                    locked_state.glyph_grid_layers[layer].glyph_grid[j] == old_glyph &&
-                    !visited[j + layer * locked_state.grid_w * locked_state.grid_h]
+                    render_glyph_grids[layer][j] == old_glyph &&
+                    !visited[j + layer * cells]
                 ){
-                    locked_state.glyph_grid_layers[layer].glyph_grid[j] = *cached_glyph;
-                    visited[j + layer * locked_state.grid_w * locked_state.grid_h] = TRUE;
+                    render_glyph_grids[layer][j] = *cached_glyph;
+                    visited[j + layer * cells] = TRUE;
                 }
             }
         }
 
         free(visited);
+
+        /* Glyphs moved, so rows that didn't change still need uploading. */
+        upload_all_rows = TRUE;
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     if(pdc_font_texture != 0)
@@ -374,7 +415,6 @@ static void ensure_glyph_grid(int min_layers)
             for(layer = grid_layers; layer < min_layers; ++layer)
             {
                 glyph_grid_layers[layer].occupancy = 0;
-                glyph_grid_layers[layer].glyph_grid = NULL;
                 glyph_grid_layers[layer].codepoint_attr = NULL;
             }
             grid_layers = min_layers;
@@ -383,7 +423,6 @@ static void ensure_glyph_grid(int min_layers)
         /* Update the glyph grids on each layer.  */
         for(layer = 0; layer < grid_layers; ++layer)
         {
-            size_t old_size = sizeof(Uint32) * grid_w * grid_h;
             size_t size = sizeof(Uint32) * SP->lines * SP->cols;
             Uint32* new_codepoints = malloc(size);
             memset(new_codepoints, 0, size);
@@ -407,31 +446,13 @@ static void ensure_glyph_grid(int min_layers)
 
             free(glyph_grid_layers[layer].codepoint_attr);
             glyph_grid_layers[layer].codepoint_attr = new_codepoints;
-
-            if(pdc_threading_mode == PDC_GL_SINGLE_THREADED_RENDERING)
-            {
-                /* The grid will get fully rewritten right before rendering
-                 * anyway, so keeping its layout doesn't matter as long as all
-                 * the old glyphs are still there (they must be kept around to
-                 * know how to perform glyph cache eviction).
-                 */
-                glyph_grid_layers[layer].glyph_grid = realloc(
-                    glyph_grid_layers[layer].glyph_grid,
-                    size
-                );
-                if(old_size < size)
-                {
-                    /* Make sure the new additions are zero-initialized */
-                    memset(
-                        glyph_grid_layers[layer].glyph_grid + grid_w * grid_h,
-                        0, old_size - size
-                    );
-                }
-            }
         }
 
+        row_versions = realloc(row_versions, sizeof(Uint32) * SP->lines);
+
         grid_w = SP->cols;
         grid_h = SP->lines;
+        touch_all_rows();
     }
 }
 
@@ -448,14 +469,14 @@ static void shrink_glyph_grid()
             ++layer;
             continue;
         }
-        free(glyph_grid_layers[layer].glyph_grid);
         free(glyph_grid_layers[layer].codepoint_attr);
         memmove(
             glyph_grid_layers+layer,
             glyph_grid_layers+layer+1,
-            grid_layers-layer-1
+            sizeof(struct glyph_grid_layer) * (grid_layers-layer-1)
         );
         grid_layers--;
+        touch_all_rows();
     }
 }
 
@@ -579,6 +600,7 @@ static void draw_glyph(
         return;
 
     ensure_glyph_grid(1);
+    row_versions[y] = current_version;
     cd = &color_grid[i];
     cd->bg_color = background;
     cd->fg_color = foreground | (gl_attrs << 24);
@@ -621,6 +643,7 @@ static void draw_cursor(int y, int x, int visibility)
         return;
 
     ensure_glyph_grid(1);
+    row_versions[y] = current_version;
     cd = &color_grid[x + y * SP->cols];
     cd->fg_color |= gl_attrs << 24;
 }
@@ -749,50 +772,90 @@ static Uint32 _blink_timer(Uint32 interval, void *param)
     return(interval);
 }
 
-void PDC_blink_text(void)
+static SDL_TimerID blinker_id = 0;
+
+/* The blink timer runs only while A_BLINK is enabled and some line of
+   the screen holds blinking text (or the text is blinked off, and has to
+   be brought back); PDC_doupdate() starts it when blinking text shows up. */
+
+static void _check_blink_timer(void)
 {
-    static SDL_TimerID blinker_id = 0;
-    int i, j, k;
+    const bool needed = ((SP->termattrs & A_BLINK)
+                         && (blinked_off || PDC_n_blinking_lines()));
 
-    if (!(SP->termattrs & A_BLINK))
+    if (!needed && blinker_id)
     {
         SDL_RemoveTimer(blinker_id);
         blinker_id = 0;
     }
-    else if (!blinker_id)
-    {
+    else if (needed && !blinker_id)
         blinker_id = SDL_AddTimer(500, _blink_timer, NULL);
-        blinked_off = TRUE;
-    }
+}
 
-    blinked_off = !blinked_off;
+void PDC_blink_text(void)
+{
+    /* blinking text starts out 'on' when the timer (re)starts */
 
-    for (i = 0; i < SP->lines; i++)
-    {
-        const chtype *srcp = curscr->_y[i];
+    if (!(SP->termattrs & A_BLINK) || !blinker_id)
+        blinked_off = FALSE;
+    else
+        blinked_off = !blinked_off;
 
-        for (j = 0; j < SP->cols; j++)
-            if (srcp[j] & A_BLINK)
-            {
-                k = j;
-                while (k < SP->cols && (srcp[k] & A_BLINK))
-                    k++;
-                PDC_transform_line(i, j, k - j, srcp + j);
-                j = k;
-            }
-    }
+    PDC_redraw_blinking_cells();
 
     PDC_doupdate();
 }
 
+/* Uploads the rows flagged in 'dirty' from a grid of 'cell_size' byte cells to
+ * the bound GL_ARRAY_BUFFER, merging adjacent rows into one glBufferSubData()
+ * call. The buffer is only reallocated when the grid size changes.
+ */
+static void upload_rows(
+    size_t *buffer_size, const void *data, size_t cell_size,
+    const Uint8 *dirty, bool all
+){
+    const size_t row_size = cell_size * render_grid_w;
+    const size_t size = row_size * render_grid_h;
+    int row = 0;
+
+    if(*buffer_size != size)
+    {
+        glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
+        *buffer_size = size;
+        return;
+    }
+    if(all)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+        return;
+    }
+    while(row < render_grid_h)
+    {
+        int start;
+        if(!dirty[row])
+        {
+            ++row;
+            continue;
+        }
+        for(start = row; row < render_grid_h && dirty[row]; ++row)
+            ;
+        glBufferSubData(
+            GL_ARRAY_BUFFER,
+            row_size * start,
+            row_size * (row - start),
+            (const Uint8*)data + row_size * start
+        );
+    }
+}
+
 void PDC_render_frame(void)
 {
     bool use_render_target = pdc_interpolation_mode == PDC_GL_INTERPOLATE_BILINEAR &&
         pdc_resize_mode != PDC_GL_RESIZE_NORMAL;
     int w, h;
-    int u_screen_size, u_glyph_size, u_fthick, u_line_color;
     SDL_Rect viewport;
-    int layer;
+    int layer, row, cells;
+    bool all;
     struct glyph_grid_layer* layers;
 
     if(pdc_threading_mode == PDC_GL_MULTI_THREADED_RENDERING)
@@ -824,14 +887,51 @@ void PDC_render_frame(void)
     viewport = locked_state.viewport;
 
     layers = locked_state.glyph_grid_layers;
+    cells = locked_state.grid_w * locked_state.grid_h;
+    all = pdc_color_buffer_size != sizeof(struct color_data) * cells;
 
-    for(layer = 0; layer < locked_state.grid_layers; ++layer)
+    if(
+        locked_state.grid_w != render_grid_w ||
+        locked_state.grid_h != render_grid_h ||
+        locked_state.grid_layers != render_grid_layers
+    ){
+        /* Layers that went away; the rest are cleared and re-resolved. */
+        for(layer = locked_state.grid_layers; layer < render_grid_layers;)
+            free(render_glyph_grids[layer++]);
+        render_glyph_grids = realloc(
+            render_glyph_grids, sizeof(Uint32*) * locked_state.grid_layers);
+        for(layer = 0; layer < locked_state.grid_layers; ++layer)
+        {
+            render_glyph_grids[layer] = realloc(
+                layer < render_grid_layers ? render_glyph_grids[layer] : NULL,
+                sizeof(Uint32) * cells
+            );
+            memset(render_glyph_grids[layer], 0, sizeof(Uint32) * cells);
+        }
+        rendered_versions = realloc(
+            rendered_versions, sizeof(Uint32) * locked_state.grid_h);
+        memset(rendered_versions, 0, sizeof(Uint32) * locked_state.grid_h);
+        render_dirty_rows = realloc(render_dirty_rows, locked_state.grid_h);
+        render_grid_w = locked_state.grid_w;
+        render_grid_h = locked_state.grid_h;
+        render_grid_layers = locked_state.grid_layers;
+        all = TRUE;
+    }
+
+    /* Only rows that changed need their glyphs looked up again. */
+    for(row = 0; row < render_grid_h; ++row)
     {
         int i;
-        for(i = 0; i < locked_state.grid_w * locked_state.grid_h; ++i)
+        render_dirty_rows[row] =
+            rendered_versions[row] != locked_state.row_versions[row];
+        rendered_versions[row] = locked_state.row_versions[row];
+        if(!all && !render_dirty_rows[row])
+            continue;
+        for(layer = 0; layer < render_grid_layers; ++layer)
+        for(i = row * render_grid_w; i < (row + 1) * render_grid_w; ++i)
         {
             Uint32 codepoint_attr = layers[layer].codepoint_attr[i];
-            layers[layer].glyph_grid[i] = get_glyph_texture_index(
+            render_glyph_grids[layer][i] = get_glyph_texture_index(
                 codepoint_attr&0x3FFFFFFFu,
                 codepoint_attr>>30u
             );
@@ -842,19 +942,18 @@ void PDC_render_frame(void)
      * them.
      */
     glBindBuffer(GL_ARRAY_BUFFER, pdc_color_buffer);
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        sizeof(struct color_data) * locked_state.grid_w * locked_state.grid_h,
-        locked_state.color_grid,
-        GL_STREAM_DRAW
+    upload_rows(
+        &pdc_color_buffer_size, locked_state.color_grid,
+        sizeof(struct color_data), render_dirty_rows, all
     );
     glBindBuffer(GL_ARRAY_BUFFER, pdc_glyph_buffer);
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        sizeof(Uint32) * locked_state.grid_w * locked_state.grid_h,
-        layers[0].glyph_grid,
-        GL_STREAM_DRAW
+    upload_rows(
+        &pdc_glyph_buffer_size, render_glyph_grids[0],
+        sizeof(Uint32), render_dirty_rows,
+        all || upload_all_rows || glyph_buffer_layer != 0
     );
+    glyph_buffer_layer = 0;
+    upload_all_rows = FALSE;
 
     SDL_GetWindowSize(pdc_window, &w, &h);
 
@@ -928,13 +1027,9 @@ void PDC_render_frame(void)
 
     /* Draw background colors */
     glUseProgram(pdc_background_shader_program);
-    u_screen_size = glGetUniformLocation(
-        pdc_background_shader_program, "screen_size");
-    glUniform2i(u_screen_size, locked_state.grid_w, locked_state.grid_h);
-
-    u_glyph_size = glGetUniformLocation(
-        pdc_background_shader_program, "glyph_size");
-    glUniform2i(u_glyph_size, pdc_fwidth, pdc_fheight);
+    glUniform2i(
+        pdc_bg_u_screen_size, locked_state.grid_w, locked_state.grid_h);
+    glUniform2i(pdc_bg_u_glyph_size, pdc_fwidth, pdc_fheight);
 
     glDrawArraysInstanced(
         GL_TRIANGLES, 0, 6, locked_state.grid_w * locked_state.grid_h
@@ -943,28 +1038,20 @@ void PDC_render_frame(void)
     /* Prepare for drawing foreground glyphs. */
     glUseProgram(pdc_foreground_shader_program);
 
-    u_screen_size = glGetUniformLocation(
-        pdc_foreground_shader_program, "screen_size");
-    glUniform2i(u_screen_size, locked_state.grid_w, locked_state.grid_h);
-
-    u_glyph_size = glGetUniformLocation(
-        pdc_foreground_shader_program, "glyph_size");
-    glUniform2i(u_glyph_size, pdc_fwidth, pdc_fheight);
+    glUniform2i(
+        pdc_fg_u_screen_size, locked_state.grid_w, locked_state.grid_h);
+    glUniform2i(pdc_fg_u_glyph_size, pdc_fwidth, pdc_fheight);
+    glUniform1i(pdc_fg_u_fthick, pdc_fthick);
 
-    u_fthick = glGetUniformLocation(pdc_foreground_shader_program, "fthick");
-    glUniform1i(u_fthick, pdc_fthick);
-
-    u_line_color = glGetUniformLocation(
-        pdc_foreground_shader_program, "line_color");
     if(locked_state.hcol >= 0)
     {
-        glUniform3f(u_line_color,
+        glUniform3f(pdc_fg_u_line_color,
             Get_RValue(locked_state.hcol_rgb)/255.0f,
             Get_GValue(locked_state.hcol_rgb)/255.0f,
             Get_BValue(locked_state.hcol_rgb)/255.0f
         );
     }
-    else glUniform3f(u_line_color, -1, -1, -1);
+    else glUniform3f(pdc_fg_u_line_color, -1, -1, -1);
 
     /* Draw foreground colors, layer by layer. */
     for(layer = 0; layer < locked_state.grid_layers; ++layer)
@@ -973,18 +1060,17 @@ void PDC_render_frame(void)
         {
             /* The first layer had to be uploaded earlier to make sure that we
              * have some data in it for the background shader as well. Which is
-             * why we only upload here if the layer isn't the first one.
+             * why we only upload here if the layer isn't the first one. The
+             * layers share one buffer, so combining layers go up whole, and
+             * the first one has to be uploaded whole on the next frame.
              */
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                sizeof(Uint32) * locked_state.grid_w * locked_state.grid_h,
-                layers[layer].glyph_grid,
-                GL_STREAM_DRAW
+            glBufferSubData(
+                GL_ARRAY_BUFFER, 0, sizeof(Uint32) * cells,
+                render_glyph_grids[layer]
             );
+            glyph_buffer_layer = layer;
         }
-        glDrawArraysInstanced(
-            GL_TRIANGLES, 0, 6, locked_state.grid_w * locked_state.grid_h
-        );
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, cells);
     }
 
     if(use_render_target)
@@ -1012,100 +1098,153 @@ void PDC_render_frame(void)
     SDL_GL_SwapWindow(pdc_window);
 }
 
-void PDC_doupdate(void)
+/* Brings a multithreaded render state up to date with the grids, copying over
+ * only the rows whose version differs from the one it already holds.
+ */
+static void fill_render_state(struct mt_render_state *state)
 {
-    ensure_glyph_grid(1);
-    shrink_glyph_grid();
-
-    if(pdc_threading_mode == PDC_GL_MULTI_THREADED_RENDERING)
-    {
-        int i;
-        size_t grid_size = sizeof(Uint32) * grid_w * grid_h;
-        size_t color_grid_size = sizeof(struct color_data) * grid_w * grid_h;
-        size_t old_grid_size;
-        size_t old_color_grid_size;
-
-        SDL_LockMutex(pdc_render_mutex);
+    int layer, row;
 
-        old_grid_size =
-            sizeof(Uint32) * submitted_state.grid_w * submitted_state.grid_h;
-        old_color_grid_size = sizeof(struct color_data) *
-            submitted_state.grid_w * submitted_state.grid_h;
-
-        /* Delete unneeded layer memory. */
-        for(i = grid_layers; i < submitted_state.grid_layers; ++i)
-        {
-            free(submitted_state.glyph_grid_layers[i].glyph_grid);
-            free(submitted_state.glyph_grid_layers[i].codepoint_attr);
-        }
-        /* Realloc enough layers. */
-        if(grid_layers != submitted_state.grid_layers)
+    if(
+        state->grid_w != grid_w ||
+        state->grid_h != grid_h ||
+        state->grid_layers != grid_layers
+    ){
+        size_t cells = (size_t)grid_w * grid_h;
+
+        /* Delete unneeded layer memory, and realloc the rest. */
+        for(layer = grid_layers; layer < state->grid_layers; ++layer)
+            free(state->glyph_grid_layers[layer].codepoint_attr);
+        state->glyph_grid_layers = realloc(
+            state->glyph_grid_layers,
+            sizeof(struct glyph_grid_layer) * grid_layers
+        );
+        for(layer = 0; layer < grid_layers; ++layer)
         {
-            submitted_state.glyph_grid_layers = realloc(
-                submitted_state.glyph_grid_layers,
-                sizeof(struct glyph_grid_layer) * grid_layers
+            state->glyph_grid_layers[layer].codepoint_attr = realloc(
+                layer < state->grid_layers ?
+                    state->glyph_grid_layers[layer].codepoint_attr : NULL,
+                sizeof(Uint32) * cells
             );
         }
-        /* Add missing layer memory and copy new data over. */
-        for(i = 0; i < grid_layers; ++i)
-        {
-            if(i >= submitted_state.grid_layers)
-            {
-                submitted_state.glyph_grid_layers[i].glyph_grid = malloc(grid_size);
-                submitted_state.glyph_grid_layers[i].codepoint_attr = malloc(grid_size);
-            }
-            else if(old_grid_size != grid_size)
-            {
-                /* The grid will get fully rewritten right before rendering
-                 * anyway, so keeping its layout doesn't matter as long as all
-                 * the old glyphs are still there (they must be kept around to
-                 * know how to perform glyph cache eviction).
-                 */
-                submitted_state.glyph_grid_layers[i].glyph_grid = realloc(
-                    submitted_state.glyph_grid_layers[i].glyph_grid,
-                    grid_size
-                );
-                if(old_grid_size < grid_size)
-                {
-                    /* Make sure the new additions are zero-initialized */
-                    memset(
-                        submitted_state.glyph_grid_layers[i].glyph_grid +
-                            submitted_state.grid_w * submitted_state.grid_h,
-                        0, old_grid_size - old_grid_size
-                    );
-                }
-                submitted_state.glyph_grid_layers[i].codepoint_attr = realloc(
-                    submitted_state.glyph_grid_layers[i].codepoint_attr,
-                    grid_size
-                );
-            }
+        state->color_grid = realloc(
+            state->color_grid, sizeof(struct color_data) * cells);
 
-            submitted_state.glyph_grid_layers[i].occupancy =
-                glyph_grid_layers[i].occupancy;
-            memcpy(
-                submitted_state.glyph_grid_layers[i].codepoint_attr,
-                glyph_grid_layers[i].codepoint_attr,
-                grid_size
-            );
-        }
+        /* No version is 0, so every row gets copied below. */
+        state->row_versions = realloc(
+            state->row_versions, sizeof(Uint32) * grid_h);
+        memset(state->row_versions, 0, sizeof(Uint32) * grid_h);
 
-        /* Copy color grid as well. */
-        if(color_grid_size != old_color_grid_size)
+        state->grid_w = grid_w;
+        state->grid_h = grid_h;
+        state->grid_layers = grid_layers;
+    }
+
+    for(row = 0; row < grid_h; ++row)
+    {
+        const int start = row * grid_w;
+
+        if(state->row_versions[row] == row_versions[row])
+            continue;
+        memcpy(
+            &state->color_grid[start],
+            &color_grid[start],
+            sizeof(struct color_data) * grid_w
+        );
+        for(layer = 0; layer < grid_layers; ++layer)
         {
-            submitted_state.color_grid = realloc(
-                submitted_state.color_grid,
-                color_grid_size
+            memcpy(
+                &state->glyph_grid_layers[layer].codepoint_attr[start],
+                &glyph_grid_layers[layer].codepoint_attr[start],
+                sizeof(Uint32) * grid_w
             );
         }
-        memcpy(submitted_state.color_grid, color_grid, color_grid_size);
+        state->row_versions[row] = row_versions[row];
+    }
+    for(layer = 0; layer < grid_layers; ++layer)
+    {
+        state->glyph_grid_layers[layer].occupancy =
+            glyph_grid_layers[layer].occupancy;
+    }
+
+    state->viewport = PDC_get_viewport();
+    state->hcol = SP->line_color;
+    if(SP->line_color > 0)
+        state->hcol_rgb = PDC_get_palette_entry(SP->line_color);
+}
+
+static void free_render_state(struct mt_render_state *state)
+{
+    int layer;
+
+    for(layer = 0; layer < state->grid_layers; ++layer)
+        free(state->glyph_grid_layers[layer].codepoint_attr);
+    free(state->glyph_grid_layers);
+    free(state->color_grid);
+    free(state->row_versions);
+    memset(state, 0, sizeof(struct mt_render_state));
+}
+
+/* Frees the grids, the render states and the render side's copies of them.
+ * The render thread, if any, must have stopped already.
+ */
+void PDC_free_render_state(void)
+{
+    int layer;
+
+    free_render_state(&filling_state);
+    free_render_state(&submitted_state);
+
+    /* In single-threaded mode, locked_state just points at the grids. */
+    if(pdc_threading_mode == PDC_GL_MULTI_THREADED_RENDERING)
+        free_render_state(&locked_state);
+    else
+        memset(&locked_state, 0, sizeof(struct mt_render_state));
+
+    for(layer = 0; layer < grid_layers; ++layer)
+        free(glyph_grid_layers[layer].codepoint_attr);
+    free(glyph_grid_layers);
+    free(color_grid);
+    free(row_versions);
+    glyph_grid_layers = NULL;
+    color_grid = NULL;
+    row_versions = NULL;
+    grid_w = grid_h = grid_layers = 0;
+
+    for(layer = 0; layer < render_grid_layers; ++layer)
+        free(render_glyph_grids[layer]);
+    free(render_glyph_grids);
+    free(rendered_versions);
+    free(render_dirty_rows);
+    render_glyph_grids = NULL;
+    rendered_versions = NULL;
+    render_dirty_rows = NULL;
+    render_grid_w = render_grid_h = render_grid_layers = 0;
+    glyph_buffer_layer = -1;
+}
+
+void PDC_doupdate(void)
+{
+    _check_blink_timer();
+    ensure_glyph_grid(1);
+    shrink_glyph_grid();
+
+    if(pdc_threading_mode == PDC_GL_MULTI_THREADED_RENDERING)
+    {
+        struct mt_render_state tmp;
+
+        fill_render_state(&filling_state);
+
+        /* Hand the filled state over. If the render thread didn't pick up the
+         * previous one, that one is simply refilled next time.
+         */
+        SDL_LockMutex(pdc_render_mutex);
+
+        memcpy(&tmp, &submitted_state, sizeof(struct mt_render_state));
+        memcpy(
+            &submitted_state, &filling_state, sizeof(struct mt_render_state));
+        memcpy(&filling_state, &tmp, sizeof(struct mt_render_state));
 
-        submitted_state.viewport = PDC_get_viewport();
-        submitted_state.hcol = SP->line_color;
-        if(SP->line_color > 0)
-            submitted_state.hcol_rgb = PDC_get_palette_entry(SP->line_color);
-        submitted_state.grid_w = grid_w;
-        submitted_state.grid_h = grid_h;
-        submitted_state.grid_layers = grid_layers;
         submitted_state.updated = 1;
 
         SDL_UnlockMutex(pdc_render_mutex);
@@ -1122,8 +1261,13 @@ void PDC_doupdate(void)
         locked_state.grid_w = grid_w;
         locked_state.grid_h = grid_h;
         locked_state.grid_layers = grid_layers;
+        locked_state.row_versions = row_versions;
         PDC_render_frame();
     }
+
+    /* Later changes must look different from the ones handed over now. */
+    if(++current_version == 0)
+        current_version = 1;
 }
 
 void PDC_pump_and_peep(void)
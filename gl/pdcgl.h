@@ -48,7 +48,11 @@ extern SDL_mutex *pdc_render_mutex;
 extern SDL_cond *pdc_render_cond;
 
 extern unsigned pdc_color_buffer, pdc_glyph_buffer;
+extern size_t pdc_color_buffer_size, pdc_glyph_buffer_size;
 extern unsigned pdc_background_shader_program, pdc_foreground_shader_program;
+extern int pdc_bg_u_screen_size, pdc_bg_u_glyph_size; /* uniform locations */
+extern int pdc_fg_u_screen_size, pdc_fg_u_glyph_size;
+extern int pdc_fg_u_fthick, pdc_fg_u_line_color;
 extern unsigned pdc_font_texture, pdc_render_target_texture;
 extern unsigned pdc_tex_fbo;
 
@@ -59,3 +63,4 @@ extern void PDC_pump_and_peep(void);
 extern void PDC_blink_text(void);
 extern SDL_Rect PDC_get_viewport(void);
 extern void PDC_render_frame(void);
+extern void PDC_free_render_state(void);
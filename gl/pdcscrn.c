@@ -45,7 +45,11 @@ int pdc_sheight = 0, pdc_swidth = 0;
 
 int pdc_fheight, pdc_fwidth, pdc_fthick;
 unsigned pdc_color_buffer = 0, pdc_glyph_buffer = 0;
+size_t pdc_color_buffer_size = 0, pdc_glyph_buffer_size = 0;
 unsigned pdc_background_shader_program = 0, pdc_foreground_shader_program = 0;
+int pdc_bg_u_screen_size = -1, pdc_bg_u_glyph_size = -1;
+int pdc_fg_u_screen_size = -1, pdc_fg_u_glyph_size = -1;
+int pdc_fg_u_fthick = -1, pdc_fg_u_line_color = -1;
 unsigned pdc_font_texture = 0, pdc_render_target_texture = 0;
 unsigned pdc_tex_fbo = 0;
 static GLuint pdc_vao = 0;
@@ -177,6 +181,8 @@ static void _clean(void)
         }
     }
 
+    PDC_free_render_state();
+
     int i;
     if (pdc_ttffont)
     {
@@ -229,6 +235,7 @@ static void _clean(void)
     pdc_tex_fbo = pdc_font_texture = pdc_render_target_texture = pdc_vao =
         pdc_color_buffer = pdc_glyph_buffer = pdc_background_shader_program =
         pdc_foreground_shader_program = 0;
+    pdc_color_buffer_size = pdc_glyph_buffer_size = 0;
 
     if(pdc_gl_context)
     {
@@ -504,6 +511,18 @@ int PDC_scr_open(void)
     );
     build_shader_program(pdc_foreground_shader_program);
 
+    /* Uniform locations don't change after linking, so they're only looked up
+     * once here instead of on every frame.
+     */
+    pdc_fg_u_screen_size = glGetUniformLocation(
+        pdc_foreground_shader_program, "screen_size");
+    pdc_fg_u_glyph_size = glGetUniformLocation(
+        pdc_foreground_shader_program, "glyph_size");
+    pdc_fg_u_fthick = glGetUniformLocation(
+        pdc_foreground_shader_program, "fthick");
+    pdc_fg_u_line_color = glGetUniformLocation(
+        pdc_foreground_shader_program, "line_color");
+
     /* Build background shader. */
     pdc_background_shader_program = glCreateProgram();
     add_shader(
@@ -517,6 +536,10 @@ int PDC_scr_open(void)
         pdc_background_fragment_shader_src
     );
     build_shader_program(pdc_background_shader_program);
+    pdc_bg_u_screen_size = glGetUniformLocation(
+        pdc_background_shader_program, "screen_size");
+    pdc_bg_u_glyph_size = glGetUniformLocation(
+        pdc_background_shader_program, "glyph_size");
 
     /* A VAO is just needed in OpenGL 3.3, even though we don't ever change the
      * vertex attribs...
@@ -508,7 +508,7 @@ int waddch( WINDOW *win, const chtype ch)
 
     assert( SP);
     assert( win);
-    if (!win || !SP)
+    if (!win || !SP || (win->_flags & _FILEPAD))
         return ERR;
 
     x = win->_curx;
@@ -649,8 +649,13 @@ int waddch( WINDOW *win, const chtype ch)
 
         if (win->_y[y][x] != text)
         {
+            chtype *line = PDC_writable_line( win, y);
+
+            if (!line)
+                return ERR;
+
             PDC_mark_cell_as_changed( win, y, x);
-            win->_y[y][x] = text;
+            line[x] = text;
         }
 
         if (++x >= win->_maxx)
@@ -29,6 +29,12 @@ addchstr
     int mvwadd_wchnstr(WINDOW *win, int y, int x, const cchar_t *wch,
                        int n);
 
+    int wadd_rgb_ch(WINDOW *win, const chtype ch, const int fg,
+                    const int bg);
+    int waddrgbnstr(WINDOW *win, const chtype *ch, const int *rgb, int n);
+    int mvwaddrgbnstr(WINDOW *win, int y, int x, const chtype *ch,
+                      const int *rgb, int n);
+
 ### Description
 
    These routines write a chtype or cchar_t string directly into the
@@ -41,9 +47,30 @@ addchstr
    newline or other special characters, nor does any line wrapping
    occur.
 
+   wadd_rgb_ch() and waddrgbnstr() write cells whose foreground and
+   background are given directly as RGB values (packed as red + green *
+   256 + blue * 65536),  rather than through a color pair,  so that a
+   picture or heat map with thousands of distinct colors needn't
+   allocate a pair for each.  For waddrgbnstr(),  rgb[2 * i] and
+   rgb[2 * i + 1] are the foreground and background for ch[i].  A
+   negative value leaves that color to the cell's pair.  The values are
+   kept in a plane alongside the window (its parent,  for a subwindow),
+   allocated on first use and freed by delwin();  A_REVERSE still swaps
+   them,  but A_BOLD,  A_DIM and A_BLINK don't alter them.  Like
+   waddch(),  wadd_rgb_ch() advances the cursor,  wrapping and
+   scrolling as needed;  waddrgbnstr() works like waddchnstr().
+
+   The RGB colors are shown by the VT (with a truecolor terminal;
+   otherwise the nearest palette entry),  framebuffer,  SDL2 and X11
+   ports.  Elsewhere,  and for cells copied to other windows by
+   copywin(),  overwrite(),  overlay() or dupwin(),  the pair colors
+   are shown.
+
 ### Return Value
 
-   All functions return OK or ERR.
+   All functions return OK or ERR.  The RGB functions return ERR for
+   sparse or file-backed pads,  in builds with 32-bit chtypes,  or if
+   the plane can't be allocated.
 
 ### Portability
                              X/Open  ncurses  NetBSD
@@ -63,11 +90,236 @@ addchstr
     wadd_wchnstr                Y       Y       Y
     mvadd_wchnstr               Y       Y       Y
     mvwadd_wchnstr              Y       Y       Y
+    wadd_rgb_ch                 -       -       -
+    waddrgbnstr                 -       -       -
+    mvwaddrgbnstr               -       -       -
 
 **man-end****************************************************************/
 
+/*man-start**************************************************************
+
+PDC_blit_rgb
+------------
+
+### Synopsis
+
+    int PDC_blit_rgb(WINDOW *win, int y, int x,
+                     const unsigned char *pixels, int w, int h,
+                     int stride, int mode);
+
+### Description
+
+   PDC_blit_rgb() draws a w by h pixel image,  given as red, green,
+   blue byte triplets with 'stride' bytes from one row to the next (0
+   meaning 3 * w),  into win with its top left corner at (y, x).
+
+   With mode PDC_BLIT_HALF_BLOCK,  each cell shows two pixels,  one
+   above the other,  as an upper half block in the top pixel's color on
+   a background of the bottom pixel's color.  With PDC_BLIT_QUADRANT,
+   each cell covers two by two pixels,  shown as one of the Unicode
+   quadrant characters in the two colors that best fit them;  in builds
+   without wide characters,  the pixels are averaged in pairs and shown
+   as half blocks.
+
+   Colors are matched to the palette and color pairs allocated with
+   alloc_pair(),  once for each distinct combination rather than once
+   per cell.  If PDC_BLIT_DIRECT is ORed into the mode,  the colors are
+   written directly as for waddrgbnstr(),  using no color pairs at all;
+   see that function for the ports that show them.
+
+   Each row of cells is written at once,  as with waddchnstr();  the
+   image is clipped to the window,  and the cursor isn't moved.
+
+### Return Value
+
+   PDC_blit_rgb() returns ERR if win or pixels is NULL,  if (y, x) is
+   outside the window,  or if color pairs or memory run out;  OK
+   otherwise.
+
+### Portability
+                             X/Open  ncurses  NetBSD
+    PDC_blit_rgb                -       -       -
+
+**man-end****************************************************************/
+
+#include <stdlib.h>
 #include <string.h>
 
+/* RGB planes hold a foreground and background value for each cell of
+a window,  and are kept in a list rather than in WINDOW so that the
+structure (part of the ABI) needn't change.  Subwindows and subpads
+share the plane of the window whose lines they use.  */
+
+struct _pdc_rgb_plane
+{
+    WINDOW *win;
+    int lines, cols;
+    uint32_t *rgb;
+    struct _pdc_rgb_plane *next;
+};
+
+/* Returns the plane value for cell (0, 0) of the window,  with 'stride'
+set to the number of values per line,  or NULL if there's no plane and
+'create' is FALSE.  A plane left over from before a wresize() is
+reallocated,  with every value set to PDC_RGB_NONE. */
+
+uint32_t *PDC_rgb_plane(WINDOW *win, int *stride, const bool create)
+{
+    struct _pdc_rgb_plane *plane;
+    int y0 = 0, x0 = 0;
+
+    if (!create && !SP->opaque->rgb_planes)
+        return NULL;
+
+    while (win->_parent)
+    {
+        if (win->_flags & _SUBPAD)
+        {
+            y0 += win->_begy;
+            x0 += win->_begx;
+        }
+        else
+        {
+            y0 += win->_pary;
+            x0 += win->_parx;
+        }
+        win = win->_parent;
+    }
+
+    for (plane = SP->opaque->rgb_planes; plane; plane = plane->next)
+        if (plane->win == win)
+            break;
+
+    if (!plane)
+    {
+        if (!create || !PDC_RGB_CELL || (win->_flags & (_SPARSE | _FILEPAD)))
+            return NULL;
+        plane = (struct _pdc_rgb_plane *)calloc(1, sizeof(*plane));
+        if (!plane)
+            return NULL;
+        plane->win = win;
+        plane->next = SP->opaque->rgb_planes;
+        SP->opaque->rgb_planes = plane;
+    }
+
+    if (plane->lines != win->_maxy || plane->cols != win->_maxx)
+    {
+        const size_t n_values = (size_t)win->_maxy * win->_maxx * 2;
+        uint32_t *rgb = (uint32_t *)realloc(plane->rgb,
+                                            n_values * sizeof(uint32_t));
+
+        if (!rgb)
+        {
+            PDC_free_rgb_plane(win);
+            return NULL;
+        }
+        memset(rgb, 0xff, n_values * sizeof(uint32_t));
+        plane->rgb = rgb;
+        plane->lines = win->_maxy;
+        plane->cols = win->_maxx;
+    }
+
+    *stride = plane->cols * 2;
+    return plane->rgb + y0 * *stride + x0 * 2;
+}
+
+void PDC_free_rgb_plane(WINDOW *win)
+{
+    struct _pdc_rgb_plane **pptr = &SP->opaque->rgb_planes;
+
+    while (*pptr && (*pptr)->win != win)
+        pptr = &(*pptr)->next;
+
+    if (*pptr)
+    {
+        struct _pdc_rgb_plane *plane = *pptr;
+
+        *pptr = plane->next;
+        free(plane->rgb);
+        free(plane);
+    }
+}
+
+/* Called by wscrl(),  winsertln() and wdeleteln(),  after lines
+top...top+n_lines-1 have been scrolled by n,  so the RGB values go with
+their cells.  The vacated lines get PDC_RGB_NONE. */
+
+void PDC_scroll_rgb_plane(WINDOW *win, const int top, const int n_lines,
+                          const int n)
+{
+    int stride, y;
+    const size_t n_bytes = win->_maxx * 2 * sizeof(uint32_t);
+    uint32_t *rgb = PDC_rgb_plane(win, &stride, FALSE);
+
+    if (!rgb)
+        return;
+
+    rgb += top * stride;
+    if (n > 0)
+    {
+        for (y = 0; y < n_lines - n; y++)
+            memcpy(rgb + y * stride, rgb + (y + n) * stride, n_bytes);
+        for (y = (n < n_lines ? n_lines - n : 0); y < n_lines; y++)
+            memset(rgb + y * stride, 0xff, n_bytes);
+    }
+    else
+    {
+        for (y = n_lines - 1; y >= -n; y--)
+            memcpy(rgb + y * stride, rgb + (y + n) * stride, n_bytes);
+        for (y = 0; y < -n && y < n_lines; y++)
+            memset(rgb + y * stride, 0xff, n_bytes);
+    }
+}
+
+/* Called by winsch() and wdelch(),  after the cells of line y from
+column x on have moved n columns right (n > 0) or -n columns left,
+so the RGB values go with their cells.  The vacated cells get
+PDC_RGB_NONE. */
+
+void PDC_shift_rgb_plane(WINDOW *win, const int y, const int x, int n)
+{
+    int stride;
+    const int n_cells = win->_maxx - x;
+    uint32_t *rgb = PDC_rgb_plane(win, &stride, FALSE);
+
+    if (!rgb || n_cells <= 0 || !n)
+        return;
+
+    rgb += y * stride + x * 2;
+    if (n >= n_cells || -n >= n_cells)
+        memset(rgb, 0xff, n_cells * 2 * sizeof(uint32_t));
+    else if (n > 0)
+    {
+        memmove(rgb + n * 2, rgb, (n_cells - n) * 2 * sizeof(uint32_t));
+        memset(rgb, 0xff, n * 2 * sizeof(uint32_t));
+    }
+    else
+    {
+        n = -n;
+        memmove(rgb, rgb + n * 2, (n_cells - n) * 2 * sizeof(uint32_t));
+        memset(rgb + (n_cells - n) * 2, 0xff, n * 2 * sizeof(uint32_t));
+    }
+}
+
+/* Stores an RGB cell,  returning TRUE if it differs from what was
+there before. */
+
+static bool _set_rgb_cell(chtype *cell, uint32_t *rgb, const chtype ch,
+                          const int fg, const int bg)
+{
+    const uint32_t new_fg = (fg < 0 ? PDC_RGB_NONE : (uint32_t)fg & 0xffffff);
+    const uint32_t new_bg = (bg < 0 ? PDC_RGB_NONE : (uint32_t)bg & 0xffffff);
+    const chtype new_ch = ch | PDC_RGB_CELL;
+
+    if (*cell == new_ch && rgb[0] == new_fg && rgb[1] == new_bg)
+        return FALSE;
+
+    *cell = new_ch;
+    rgb[0] = new_fg;
+    rgb[1] = new_bg;
+    return TRUE;
+}
+
 int waddchnstr(WINDOW *win, const chtype *ch, int n)
 {
     int y, x;
@@ -82,7 +334,10 @@ int waddchnstr(WINDOW *win, const chtype *ch, int n)
 
     x = win->_curx;
     y = win->_cury;
-    ptr = &(win->_y[y][x]);
+    ptr = PDC_writable_line(win, y);
+    if (!ptr)
+        return ERR;
+    ptr += x;
 
     if (n == -1 || n > win->_maxx - x)
         n = win->_maxx - x;
@@ -160,6 +415,333 @@ int mvwaddchnstr(WINDOW *win, int y, int x, const chtype *ch, int n)
     return waddchnstr(win, ch, n);
 }
 
+int wadd_rgb_ch(WINDOW *win, const chtype ch, const int fg, const int bg)
+{
+    int y, x, stride;
+    chtype *ptr;
+    uint32_t *rgb;
+
+    PDC_LOG(("wadd_rgb_ch() - called: win=%p ch=%x fg=%x bg=%x\n",
+             win, ch, fg, bg));
+
+    assert( win);
+    if (!win)
+        return ERR;
+
+    x = win->_curx;
+    y = win->_cury;
+    if (y >= win->_maxy || x >= win->_maxx || y < 0 || x < 0)
+        return ERR;
+
+    rgb = PDC_rgb_plane(win, &stride, TRUE);
+    ptr = PDC_writable_line(win, y);
+    if (!rgb || !ptr)
+        return ERR;
+
+    if (_set_rgb_cell(ptr + x, rgb + y * stride + x * 2, ch, fg, bg))
+        PDC_mark_cell_as_changed(win, y, x);
+
+    if (++x >= win->_maxx)
+    {
+        /* wrap around test */
+
+        x = 0;
+
+        if (++y > win->_bmarg)
+        {
+            y--;
+
+            if (wscrl(win, 1) == ERR)
+            {
+                PDC_sync(win);
+                return ERR;
+            }
+        }
+    }
+
+    win->_curx = x;
+    win->_cury = y;
+
+    if (win->_immed)
+        wrefresh(win);
+    if (win->_sync)
+        wsyncup(win);
+
+    return OK;
+}
+
+int waddrgbnstr(WINDOW *win, const chtype *ch, const int *rgb, int n)
+{
+    int y, x, stride;
+    chtype *ptr;
+    uint32_t *plane;
+
+    PDC_LOG(("waddrgbnstr() - called: win=%p n=%d\n", win, n));
+
+    assert( win);
+    assert( ch);
+    assert( rgb);
+    if (!win || !ch || !rgb || !n || n < -1)
+        return ERR;
+
+    x = win->_curx;
+    y = win->_cury;
+    plane = PDC_rgb_plane(win, &stride, TRUE);
+    ptr = PDC_writable_line(win, y);
+    if (!plane || !ptr)
+        return ERR;
+    ptr += x;
+    plane += y * stride + x * 2;
+
+    if (n == -1 || n > win->_maxx - x)
+        n = win->_maxx - x;
+
+    for (; n && *ch; n--, x++, ptr++, ch++, rgb += 2, plane += 2)
+        if (_set_rgb_cell(ptr, plane, *ch, rgb[0], rgb[1]))
+            PDC_mark_cell_as_changed( win, y, x);
+
+    return OK;
+}
+
+int mvwaddrgbnstr(WINDOW *win, int y, int x, const chtype *ch,
+                  const int *rgb, int n)
+{
+    PDC_LOG(("mvwaddrgbnstr() - called: y %d x %d n %d \n", y, x, n));
+
+    if (wmove(win, y, x) == ERR)
+        return ERR;
+
+    return waddrgbnstr(win, ch, rgb, n);
+}
+
+#define BLIT_PACK( r, g, b)  ((int)(r) | ((int)(g) << 8) | ((int)(b) << 16))
+#define BLIT_DIST( a, b)  ((long)(((a) & 0xff) - ((b) & 0xff)) \
+                                * (((a) & 0xff) - ((b) & 0xff)) \
+                + (long)(((a) >> 8 & 0xff) - ((b) >> 8 & 0xff)) \
+                                * (((a) >> 8 & 0xff) - ((b) >> 8 & 0xff)) \
+                + (long)(((a) >> 16) - ((b) >> 16)) * (((a) >> 16) - ((b) >> 16)))
+
+/* Converts one row of cells to glyphs and packed foreground/background
+colors.  No library calls are made here,  so the per-cell work can be
+kept in registers (and,  for half blocks,  vectorized). */
+
+static void _blit_row_colors(const unsigned char *top,
+                             const unsigned char *bottom, const int n_cells,
+                             const int mode, chtype *glyphs, int *rgb)
+{
+    int i;
+
+    if ((mode & PDC_BLIT_QUADRANT) == 0)
+    {
+        for (i = 0; i < n_cells; i++, top += 3, bottom += 3)
+        {
+            rgb[2 * i] = BLIT_PACK(top[0], top[1], top[2]);
+            rgb[2 * i + 1] = BLIT_PACK(bottom[0], bottom[1], bottom[2]);
+            glyphs[i] = ACS_UBLOCK;
+        }
+        return;
+    }
+
+    for (i = 0; i < n_cells; i++, top += 6, bottom += 6)
+    {
+#ifdef PDC_WIDE
+        /* Unicode quadrant characters,  indexed by which of the top
+           left (1), top right (2), bottom left (4) and bottom right (8)
+           pixels are in the foreground color */
+
+        static const chtype quadrants[16] = { ' ', 0x2598, 0x259d,
+                    0x2580, 0x2596, 0x258c, 0x259e, 0x259b, 0x2597,
+                    0x259a, 0x2590, 0x259c, 0x2584, 0x2599, 0x259f,
+                    0x2588 };
+        const int px[4] = { BLIT_PACK(top[0], top[1], top[2]),
+                            BLIT_PACK(top[3], top[4], top[5]),
+                            BLIT_PACK(bottom[0], bottom[1], bottom[2]),
+                            BLIT_PACK(bottom[3], bottom[4], bottom[5]) };
+        int sums[2][3], counts[2], j, k, a = 0, b = 1, mask = 0;
+        long max_dist = -1;
+
+        /* the two pixels furthest apart seed the two colors;  the
+           others go with whichever they're closer to */
+
+        for (j = 0; j < 3; j++)
+            for (k = j + 1; k < 4; k++)
+                if (BLIT_DIST(px[j], px[k]) > max_dist)
+                {
+                    max_dist = BLIT_DIST(px[j], px[k]);
+                    a = j;
+                    b = k;
+                }
+        if (!max_dist)           /* all four pixels alike */
+        {
+            rgb[2 * i] = rgb[2 * i + 1] = px[0];
+            glyphs[i] = quadrants[3];
+            continue;
+        }
+        memset(sums, 0, sizeof(sums));
+        counts[0] = counts[1] = 0;
+        for (j = 0; j < 4; j++)
+        {
+            const int fore = (j == a || (j != b &&
+                     BLIT_DIST(px[j], px[a]) <= BLIT_DIST(px[j], px[b])));
+
+            if (fore)
+                mask |= 1 << j;
+            sums[fore][0] += px[j] & 0xff;
+            sums[fore][1] += (px[j] >> 8) & 0xff;
+            sums[fore][2] += px[j] >> 16;
+            counts[fore]++;
+        }
+        rgb[2 * i] = BLIT_PACK(sums[1][0] / counts[1], sums[1][1] / counts[1],
+                               sums[1][2] / counts[1]);
+        rgb[2 * i + 1] = BLIT_PACK(sums[0][0] / counts[0],
+                               sums[0][1] / counts[0], sums[0][2] / counts[0]);
+        glyphs[i] = quadrants[mask];
+#else
+        rgb[2 * i] = BLIT_PACK((top[0] + top[3]) >> 1, (top[1] + top[4]) >> 1,
+                               (top[2] + top[5]) >> 1);
+        rgb[2 * i + 1] = BLIT_PACK((bottom[0] + bottom[3]) >> 1,
+                     (bottom[1] + bottom[4]) >> 1, (bottom[2] + bottom[5]) >> 1);
+        glyphs[i] = ACS_UBLOCK;
+#endif
+    }
+}
+
+/* Nearest palette entry for a packed RGB value: exact with a full RGB
+palette,  else from the xterm 6x6x6 cube and gray ramp (entries 16-255),
+else from the first 8 or 16 colors,  whose values are in 'basic'. */
+
+static int _blit_color_index(const int rgb, const int *basic)
+{
+    int i, best = 0;
+    long best_dist;
+
+    if (COLORS >= 256 + 0x1000000)
+        return 256 + rgb;
+
+    if (COLORS >= 256)
+    {
+        static const int levels[6] = { 0, 95, 135, 175, 215, 255 };
+        int c[3], idx[3], gray;
+
+        for (i = 0; i < 3; i++)
+        {
+            c[i] = (rgb >> (i * 8)) & 0xff;
+            idx[i] = (c[i] < 48 ? 0 : (c[i] < 115 ? 1 : (c[i] - 35) / 40));
+        }
+        gray = (c[0] + c[1] + c[2]) / 3;
+        gray = (gray < 8 ? 0 : (gray > 238 ? 23 : (gray - 3) / 10));
+        i = BLIT_PACK(levels[idx[0]], levels[idx[1]], levels[idx[2]]);
+        best = gray * 10 + 8;
+        if (BLIT_DIST(rgb, BLIT_PACK(best, best, best)) < BLIT_DIST(rgb, i))
+            return 232 + gray;
+        return 16 + idx[0] * 36 + idx[1] * 6 + idx[2];
+    }
+
+    best_dist = BLIT_DIST(rgb, basic[0]);
+    for (i = 1; i < COLORS && i < 16; i++)
+        if (BLIT_DIST(rgb, basic[i]) < best_dist)
+        {
+            best_dist = BLIT_DIST(rgb, basic[i]);
+            best = i;
+        }
+    return best;
+}
+
+#define BLIT_CACHE_SIZE 256
+
+int PDC_blit_rgb(WINDOW *win, int y, int x, const unsigned char *pixels,
+                 int w, int h, int stride, int mode)
+{
+    const int cell_width = ((mode & PDC_BLIT_QUADRANT) ? 2 : 1);
+    const bool direct = ((mode & PDC_BLIT_DIRECT) && PDC_RGB_CELL);
+    int basic[16], n_cols, n_rows, row, i, rval = OK;
+    int cache_key[BLIT_CACHE_SIZE][2], cache_pair[BLIT_CACHE_SIZE];
+    int save_y, save_x;
+    chtype *glyphs;
+    int *rgb;
+
+    PDC_LOG(("PDC_blit_rgb() - called: y %d x %d w %d h %d mode %d\n",
+             y, x, w, h, mode));
+
+    assert( win);
+    assert( pixels);
+    if (!win || !pixels || y < 0 || x < 0 || y >= win->_maxy
+                                          || x >= win->_maxx)
+        return ERR;
+
+    if (!stride)
+        stride = w * 3;
+    n_cols = min(w / cell_width, win->_maxx - x);
+    n_rows = min((h + 1) / 2, win->_maxy - y);
+    if (n_cols <= 0 || n_rows <= 0)
+        return OK;
+
+    glyphs = (chtype *)malloc(n_cols * (sizeof(chtype) + 2 * sizeof(int)));
+    if (!glyphs)
+        return ERR;
+    rgb = (int *)(glyphs + n_cols);
+
+    for (i = 0; !direct && i < 16 && i < COLORS; i++)
+    {
+        short r, g, b;
+
+        color_content((short)i, &r, &g, &b);
+        basic[i] = BLIT_PACK(r * 255 / 1000, g * 255 / 1000, b * 255 / 1000);
+    }
+    for (i = 0; i < BLIT_CACHE_SIZE; i++)
+        cache_key[i][0] = -1;
+
+    save_y = win->_cury;
+    save_x = win->_curx;
+    for (row = 0; row < n_rows; row++)
+    {
+        const unsigned char *top = pixels + (long)row * 2 * stride;
+        const unsigned char *bottom = (row * 2 + 1 < h ? top + stride : top);
+
+        _blit_row_colors(top, bottom, n_cols, mode, glyphs, rgb);
+        win->_cury = y + row;
+        win->_curx = x;
+        if (direct)
+        {
+            if (waddrgbnstr(win, glyphs, rgb, n_cols) == ERR)
+                rval = ERR;
+            continue;
+        }
+
+        /* colors to pairs;  neighboring cells are mostly alike,  so a
+           small cache saves most of the alloc_pair() calls */
+
+        for (i = 0; i < n_cols; i++)
+        {
+            const int fg = rgb[2 * i], bg = rgb[2 * i + 1];
+            const int slot = (int)(((unsigned)fg * 31u + (unsigned)bg * 17u
+                                  + ((unsigned)bg >> 13)) % BLIT_CACHE_SIZE);
+
+            if (cache_key[slot][0] != fg || cache_key[slot][1] != bg)
+            {
+                cache_key[slot][0] = fg;
+                cache_key[slot][1] = bg;
+                cache_pair[slot] = alloc_pair(_blit_color_index(fg, basic),
+                                              _blit_color_index(bg, basic));
+            }
+            if (cache_pair[slot] < 0)
+            {
+                cache_key[slot][0] = -1;
+                rval = ERR;
+            }
+            else
+                glyphs[i] |= COLOR_PAIR(cache_pair[slot]);
+        }
+        if (waddchnstr(win, glyphs, n_cols) == ERR)
+            rval = ERR;
+    }
+    win->_cury = save_y;
+    win->_curx = save_x;
+
+    free(glyphs);
+    return rval;
+}
+
 #ifdef PDC_WIDE
 int wadd_wchnstr(WINDOW *win, const cchar_t *wch, int n)
 {
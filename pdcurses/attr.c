@@ -361,7 +361,9 @@ int wchgat(WINDOW *win, int n, attr_t attr, short color, const void *opts)
 
     startpos = win->_curx;
     endpos = ((n < 0) ? win->_maxx : min(startpos + n, win->_maxx)) - 1;
-    dest = win->_y[win->_cury];
+    dest = PDC_writable_line(win, win->_cury);
+    if (!dest)
+        return ERR;
 
     for (n = startpos; n <= endpos; n++)
         dest[n] = (dest[n] & A_CHARTEXT) | newattr;
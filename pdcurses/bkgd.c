@@ -66,7 +66,7 @@ bkgd
 
 int wbkgd(WINDOW *win, chtype ch)
 {
-    int x, y;
+    int x, y, nlines;
     chtype oldcolr, oldch, newcolr, newch, colr, attr;
     chtype oldattr = 0, newattr = 0;
     chtype *winptr;
@@ -94,11 +94,22 @@ int wbkgd(WINDOW *win, chtype ch)
 
     newch = win->_bkgd & A_CHARTEXT;
 
+    /* a sparse pad's blank lines all share the line after the last,
+       which gets converted just once, along with the other lines */
+
+    nlines = win->_maxy;
+    if (win->_flags & _SPARSE)
+        nlines++;
+
     /* what follows is what seems to occur in the System V
        implementation of this routine */
 
-    for (y = 0; y < win->_maxy; y++)
+    for (y = 0; y < nlines; y++)
     {
+        if (y < win->_maxy && (win->_flags & _SPARSE) &&
+            win->_y[y] == _SPARSE_BLANK_LINE(win))
+            continue;
+
         for (x = 0; x < win->_maxx; x++)
         {
             winptr = win->_y[y] + x;
@@ -186,6 +186,10 @@ int wborder(WINDOW *win, chtype ls, chtype rs, chtype ts, chtype bs,
     bl = _attr_passthru(win, bl ? bl : def_val + 3);
     br = _attr_passthru(win, br ? br : def_val);
 
+    for (i = 0; i <= ymax; i++)
+        if (!PDC_writable_line(win, i))
+            return ERR;
+
     for (i = 1; i < xmax; i++)
     {
         win->_y[0][i] = ts;
@@ -244,7 +248,9 @@ int whline(WINDOW *win, chtype ch, int n)
 
     startpos = win->_curx;
     endpos = min(startpos + n, win->_maxx) - 1;
-    dest = win->_y[win->_cury];
+    dest = PDC_writable_line(win, win->_cury);
+    if (!dest)
+        return ERR;
     ch = _attr_passthru(win, ch ? ch : ACS_HLINE);
 
     for (n = startpos; n <= endpos; n++)
@@ -303,7 +309,11 @@ int wvline(WINDOW *win, chtype ch, int n)
 
     for (n = win->_cury; n < endpos; n++)
     {
-        win->_y[n][x] = ch;
+        chtype *dest = PDC_writable_line(win, n);
+
+        if (!dest)
+            return ERR;
+        dest[x] = ch;
         PDC_mark_cell_as_changed( win, n, x);
     }
 
@@ -70,8 +70,15 @@ int wclrtoeol(WINDOW *win)
 
     blank = win->_bkgd;
 
-    for (minx = x, ptr = &win->_y[y][x]; minx < win->_maxx; minx++, ptr++)
-        *ptr = blank;
+    if (x || !PDC_release_line(win, y, blank))
+    {
+        ptr = PDC_writable_line(win, y);
+        if (!ptr)
+            return ERR;
+
+        for (minx = x, ptr += x; minx < win->_maxx; minx++, ptr++)
+            *ptr = blank;
+    }
 
     PDC_mark_cells_as_changed( win, y, x, win->_maxx - 1);
 
@@ -88,7 +95,7 @@ int clrtoeol(void)
 
 int wclrtobot(WINDOW *win)
 {
-    int savey, savex;
+    int savey, savex, rval = OK;
 
     PDC_LOG(("wclrtobot() - called\n"));
 
@@ -106,14 +113,16 @@ int wclrtobot(WINDOW *win)
         win->_curx = 0;
         win->_cury++;
         for (; win->_maxy > win->_cury; win->_cury++)
-            wclrtoeol(win);
+            if (wclrtoeol(win) == ERR)
+                rval = ERR;
         win->_cury = savey;
         win->_curx = savex;
     }
-    wclrtoeol(win);
+    if (wclrtoeol(win) == ERR)
+        rval = ERR;
 
     PDC_sync(win);
-    return OK;
+    return rval;
 }
 
 int clrtobot(void)
@@ -50,8 +50,9 @@ color
    values of the foreground and background colors. The pair number must
    be between 0 and COLOR_PAIRS - 1, inclusive. The foreground and
    background must be between 0 and COLORS - 1, inclusive. If the color
-   pair was previously initialized, the screen is refreshed, and all
-   occurrences of that color-pair are changed to the new definition.
+   pair was previously initialized, all occurrences of that color-pair
+   on the screen are changed to the new definition at the next
+   doupdate().
 
    pair_content() is used to determine what the colors of a given color-
    pair consist of.
@@ -279,65 +280,75 @@ static void _normalize(int *fg, int *bg)
 }
 
 /* When a color pair is reset,  all cells of that color should be
-redrawn. refresh() and doupdate() don't redraw for color pair changes,
-so we have to redraw that text specifically.  The following test is
-equivalent to 'if( pair == (int)PAIR_NUMBER( *line))',  but saves a
-few cycles by not shifting.  */
-
-#define USES_TARGET_PAIR( ch)  (!(((ch) ^ mask) & A_COLOR))
+redrawn.  refresh() and doupdate() don't redraw for color pair changes
+on their own,  so the pair is noted here,  and the next doupdate() will
+redraw the cells showing it (see _spoil_cells_to_redraw() in refresh.c).
+Any number of pairs can be changed between updates for the cost of one
+pass over the affected lines.  If the pair can't be noted,  we fall back
+on redrawing the whole screen. */
 
 static void _set_cells_to_refresh_for_pair_change( const int pair)
 {
-    int x, y;
-    const chtype mask = ((chtype)pair << PDC_COLOR_SHIFT);
+    struct _opaque_screen_t *optr = SP->opaque;
+
+    assert( curscr);
+    if( curscr->_clear)         /* everything gets redrawn anyway */
+        return;
+    if( pair / 8 >= optr->pairs_to_redraw_size)
+    {
+        int new_size = (optr->pairs_to_redraw_size ? optr->pairs_to_redraw_size : 32);
+        unsigned char *new_bits;
 
-    assert( SP->lines);
-    assert( curscr && curscr->_y);
-    if( !curscr->_clear)
-        for( y = 0; y < SP->lines; y++)
+        while( pair / 8 >= new_size)
+            new_size *= 2;
+        new_bits = (unsigned char *)realloc( optr->pairs_to_redraw, new_size);
+        if( !new_bits)
         {
-            chtype *line = curscr->_y[y];
-
-            assert( line);
-            for( x = 0; x < SP->cols; x++)
-                if( USES_TARGET_PAIR( line[x]))
-                {
-                    const int start_x = x++;
-
-                    while( x < SP->cols && USES_TARGET_PAIR( line[x]))
-                        x++;
-                    PDC_transform_line( y, start_x, x - start_x, line + start_x);
-                }
+            curscr->_clear = TRUE;
+            return;
         }
+        memset( new_bits + optr->pairs_to_redraw_size, 0,
+                               new_size - optr->pairs_to_redraw_size);
+        optr->pairs_to_redraw = new_bits;
+        optr->pairs_to_redraw_size = new_size;
+    }
+    if( !optr->pair_blooms_to_redraw)
+        optr->min_pair_to_redraw = optr->max_pair_to_redraw = pair;
+    else if( pair < optr->min_pair_to_redraw)
+        optr->min_pair_to_redraw = pair;
+    else if( pair > optr->max_pair_to_redraw)
+        optr->max_pair_to_redraw = pair;
+    optr->pairs_to_redraw[pair >> 3] |= (unsigned char)( 1 << (pair & 7));
+    optr->pair_blooms_to_redraw |= PDC_PAIR_BLOOM_BIT( pair);
 }
 
 /* Similarly,  if PDC_set_bold(),  PDC_set_blink(),  or
 PDC_set_line_color() is called (and changes the way in which text
 with those attributes is drawn),  the corresponding text should be
-redrawn.    */
+redrawn at the next doupdate(). */
 
 void PDC_set_cells_to_refresh_for_attr_change( const chtype attr)
 {
-    int x, y;
+    assert( SP && SP->opaque);
+    SP->opaque->attrs_to_redraw |= attr;
+}
 
-    assert( SP->lines);
-    assert( curscr && curscr->_y);
-    if( !curscr->_clear)
-        for( y = 0; y < SP->lines; y++)
-        {
-            chtype *line = curscr->_y[y];
-
-            assert( line);
-            for( x = 0; x < SP->cols; x++)
-                if( !(*line & attr))
-                {
-                    const int start_x = x++;
-
-                    while( x < SP->cols && !(*line & attr))
-                        x++;
-                    PDC_transform_line( y, start_x, x - start_x, line + start_x);
-                }
-        }
+/* Discards the colors PDC_get_rgb_values() has cached for 'pair',  or
+for all pairs if pair < 0.  Ports that resolve colors through
+common/pdccolor.c fill the cache;  it's emptied here whenever a pair is
+set,  and by PDC_set_palette_entry() when a color changes. */
+
+void PDC_reset_pair_rgbs( const int pair)
+{
+    assert( SP && SP->opaque);
+    if( pair < 0)
+    {
+        free( SP->opaque->pair_rgbs);
+        SP->opaque->pair_rgbs = NULL;
+        SP->opaque->pair_rgbs_allocated = 0;
+    }
+    else if( pair < SP->opaque->pair_rgbs_allocated)
+        SP->opaque->pair_rgbs[pair].valid = 0;
 }
 
 static void _init_pair_core(int pair, int fg, int bg)
@@ -405,6 +416,7 @@ static void _init_pair_core(int pair, int fg, int bg)
     }
     if( pair)
        _link_color_pair( pair, (p->f == UNSET_COLOR_PAIR ? SP->opaque->pairs_allocated : 0));
+    PDC_reset_pair_rgbs( pair);
     if( refresh_pair)
         _set_cells_to_refresh_for_pair_change( pair);
 }
@@ -580,6 +592,10 @@ void PDC_free_atrtab(void)
     SP->opaque->pair_hash_tbl_size = SP->opaque->pair_hash_tbl_used = 0;
     if( SP->opaque->pairs)
        free( SP->opaque->pairs);
+    PDC_reset_pair_rgbs( -1);
+    free( SP->opaque->pairs_to_redraw);
+    free( SP->opaque->line_pair_blooms);
+    free( SP->opaque->blink_spans);
     free( SP->opaque);
     SP->opaque = NULL;
 }
@@ -52,13 +52,16 @@ int wdelch(WINDOW *win)
     y = win->_cury;
     x = win->_curx;
     maxx = win->_maxx - 1;
-    temp1 = &win->_y[y][x];
+    temp1 = PDC_writable_line(win, y);
+    if (!temp1)
+        return ERR;
 
-    memmove(temp1, temp1 + 1, (maxx - x) * sizeof(chtype));
+    memmove(temp1 + x, temp1 + x + 1, (maxx - x) * sizeof(chtype));
+    PDC_shift_rgb_plane(win, y, x, -1);
 
     /* wrs (4/10/93) account for window background */
 
-    win->_y[y][maxx] = win->_bkgd;
+    temp1[maxx] = win->_bkgd;
 
     PDC_mark_cells_as_changed( win, y, x, maxx);
 
@@ -62,7 +62,7 @@ int wdeleteln(WINDOW *win)
     PDC_LOG(("wdeleteln() - called\n"));
 
     assert( win);
-    if (!win)
+    if (!win || (win->_flags & _FILEPAD))      /* file pads are read-only */
         return ERR;
 
     /* wrs (4/10/93) account for window background */
@@ -77,13 +77,26 @@ int wdeleteln(WINDOW *win)
         PDC_mark_line_as_changed( win, y);
     }
 
-    for (ptr = temp; (ptr - temp < win->_maxx); ptr++)
-        *ptr = blank;           /* make a blank line */
+    y = win->_cury;
 
     if (win->_cury <= win->_bmarg)
     {
-        PDC_mark_line_as_changed( win, win->_bmarg);
-        win->_y[win->_bmarg] = temp;
+        y = win->_bmarg;
+        PDC_mark_line_as_changed( win, y);
+        win->_y[y] = temp;
+        PDC_scroll_rgb_plane(win, win->_cury, y - win->_cury + 1, 1);
+    }
+    else
+        PDC_scroll_rgb_plane(win, y, 1, 1);
+
+    if (!PDC_release_line(win, y, blank))
+    {
+        temp = PDC_writable_line(win, y);
+        if (!temp)
+            return ERR;
+
+        for (ptr = temp; (ptr - temp < win->_maxx); ptr++)
+            *ptr = blank;           /* make a blank line */
     }
 
     return OK;
@@ -158,7 +171,7 @@ int winsertln(WINDOW *win)
     PDC_LOG(("winsertln() - called\n"));
 
     assert( win);
-    if (!win)
+    if (!win || (win->_flags & _FILEPAD))      /* file pads are read-only */
         return ERR;
 
     /* wrs (4/10/93) account for window background */
@@ -174,9 +187,17 @@ int winsertln(WINDOW *win)
     }
 
     win->_y[win->_cury] = temp;
+    PDC_scroll_rgb_plane(win, win->_cury, win->_maxy - win->_cury, -1);
 
-    for (end = &temp[win->_maxx - 1]; temp <= end; temp++)
-        *temp = blank;
+    if (!PDC_release_line(win, win->_cury, blank))
+    {
+        temp = PDC_writable_line(win, win->_cury);
+        if (!temp)
+            return ERR;
+
+        for (end = &temp[win->_maxx - 1]; temp <= end; temp++)
+            *temp = blank;
+    }
 
     PDC_mark_line_as_changed( win, win->_cury);
 
@@ -152,9 +152,13 @@ int winsch(WINDOW *win, chtype ch)
         ch |= attr;
 
         maxx = win->_maxx;
-        temp = &win->_y[y][x];
+        temp = PDC_writable_line(win, y);
+        if (!temp)
+            return ERR;
+        temp += x;
 
         memmove(temp + 1, temp, (maxx - x - 1) * sizeof(chtype));
+        PDC_shift_rgb_plane(win, y, x, 1);
 
         PDC_mark_cells_as_changed( win, y, x, maxx - 1);
 
@@ -84,6 +84,14 @@ static int _copy_win(const WINDOW *src_w, WINDOW *dst_w, int src_tr,
             if ((*w1ptr) != (*w2ptr) &&
                 !((*w1ptr & A_CHARTEXT) == ' ' && _overlay))
             {
+                if (fc == _NO_CHANGE)   /* first write to this line */
+                {
+                    w2ptr = PDC_writable_line(dst_w, line + dst_tr);
+                    if (!w2ptr)
+                        return ERR;
+                    w2ptr += dst_tc + col;
+                }
+
                 *w2ptr = *w1ptr;
 
                 if (fc == _NO_CHANGE)
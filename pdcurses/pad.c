@@ -11,6 +11,9 @@ pad
 ### Synopsis
 
     WINDOW *newpad(int nlines, int ncols);
+    WINDOW *newpad_sparse(int nlines, int ncols);
+    WINDOW *newpad_file(const char *filename, int ncols);
+    int file_pad_lines(WINDOW *pad, bool *complete);
     WINDOW *subpad(WINDOW *orig, int nlines, int ncols,
                    int begy, int begx);
     int prefresh(WINDOW *win, int py, int px, int sy1, int sx1,
@@ -36,6 +39,36 @@ pad
 
    newpad() creates a new pad data structure.
 
+   newpad_sparse() creates a pad that allocates memory for a line only
+   when something is first written to it; until then, all unwritten
+   lines share a single blank line. It is otherwise used exactly like a
+   pad from newpad(), and is meant for very tall pads, such as log
+   viewers, where most lines are blank at any given time. Lines that
+   are cleared in full, e.g. by werase(), go back to sharing the blank
+   line, unless the pad has sub-pads.
+
+   newpad_file() creates a read-only pad showing the contents of a text
+   file, ncols columns wide, with one pad line per line of the file;
+   longer lines are cut off. The file is memory-mapped where the system
+   allows it (otherwise it's read into memory), and is never read in
+   full up front: each pnoutrefresh() finds and lays out only the lines
+   it shows, keeping a small number of recently shown lines ready, and
+   then indexes a further part of the file. Tabs are expanded, control
+   characters are shown as by unctrl(), and in wide-character builds
+   the text is taken to be multibyte, laid out as waddch() would:
+   fullwidth characters take two columns, and combining marks join the
+   character before them. The py argument to pnoutrefresh() is a line
+   number in the file; lines past the end are shown as blank. The file
+   must not be truncated while the pad exists. Functions that would
+   write to such a pad return ERR (its background can still be set with
+   wbkgd()), and it can't have sub-pads.
+
+   file_pad_lines() returns the number of lines of the file found so
+   far, after indexing a further part of it; complete, if not NULL, is
+   set to TRUE once the whole file has been indexed, at which point the
+   count is the number of lines in the file. A viewer can call it while
+   idle to finish the index, e.g. to size a scroll bar.
+
    subpad() creates a new sub-pad within a pad, at position (begy,
    begx), with dimensions of nlines lines and ncols columns. This
    position is relative to the pad, and not to the screen as with
@@ -60,11 +93,17 @@ pad
 
 ### Return Value
 
-   All functions except is_pad() return OK on success and ERR on error.
+   newpad(), newpad_sparse(), newpad_file() and subpad() return a
+   pointer to the new pad, or NULL on error. file_pad_lines() returns a
+   line count, or ERR if pad isn't from newpad_file(). The other
+   functions except is_pad() return OK on success and ERR on error.
 
 ### Portability
                              X/Open  ncurses  NetBSD
     newpad                      Y       Y       Y
+    newpad_sparse               -       -       -
+    newpad_file                 -       -       -
+    file_pad_lines              -       -       -
     subpad                      Y       Y       Y
     prefresh                    Y       Y       Y
     pnoutrefresh                Y       Y       Y
@@ -76,27 +115,164 @@ pad
 
 void PDC_add_window_to_list( WINDOW *win);
 
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+
+#if defined( __unix__) || defined( __APPLE__)
+   #define USE_MMAP
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+#endif
 
-/* save values for pechochar() */
+/* Rather than one block of nlines * ncols cells, each line of a sparse
+   pad starts out pointing at a single shared blank line, and only gets
+   storage of its own when something is written to it. Anything writing
+   to a window's lines must get at them through PDC_writable_line();
+   reading through win->_y works as for any other window. */
 
-WINDOW *newpad(int nlines, int ncols)
+WINDOW *PDC_makesparselines(WINDOW *win)
 {
-    WINDOW *win;
+    chtype **lines, *blank;
+    int i;
 
-    PDC_LOG(("newpad() - called: lines=%d cols=%d\n", nlines, ncols));
+    PDC_LOG(("PDC_makesparselines() - called\n"));
+
+    assert( win);
+    if (!win)
+        return (WINDOW *)NULL;
+
+    /* make room for the shared blank line past the last line */
+
+    lines = (chtype **)realloc(win->_y, (win->_maxy + 1) * sizeof(chtype *));
+    if (lines)
+        win->_y = lines;
+
+    blank = (chtype *)malloc(win->_maxx * sizeof(chtype));
+    if (!lines || !blank)
+    {
+        free(blank);
+        win->_y[0] = NULL;
+        delwin( win);
+        return (WINDOW *)NULL;
+    }
+
+    for (i = 0; i < win->_maxx; i++)
+        blank[i] = win->_bkgd;
+
+    for (i = 0; i <= win->_maxy; i++)
+        win->_y[i] = blank;
+
+    win->_flags |= _SPARSE;
+
+    return win;
+}
+
+void PDC_free_sparse_lines(WINDOW *win)
+{
+    chtype *blank = _SPARSE_BLANK_LINE(win);
+    int i;
+
+    for (i = 0; i < win->_maxy; i++)
+        if (win->_y[i] != blank)
+            free(win->_y[i]);
+
+    free(blank);
+}
+
+/* Returns line y of the window, ready to be written to -- for a sparse
+   pad, first giving the line storage of its own if it's still shared.
+   Returns NULL if that storage can't be allocated, or for a file pad,
+   whose lines are only a cache of the file and can't be written. */
+
+chtype *PDC_writable_line(WINDOW *win, const int y)
+{
+    chtype *line;
+
+    assert( win);
+    assert( y >= 0 && y < win->_maxy);
+
+    if (win->_flags & _FILEPAD)
+        return NULL;
+
+    line = win->_y[y];
+
+    if ((win->_flags & _SPARSE) && line == _SPARSE_BLANK_LINE(win))
+    {
+        line = (chtype *)malloc(win->_maxx * sizeof(chtype));
+        if (line)
+        {
+            memcpy(line, win->_y[y], win->_maxx * sizeof(chtype));
+            win->_y[y] = line;
+        }
+    }
+
+    return line;
+}
+
+static bool _has_subwindows(const WINDOW *win)
+{
+    int i;
+
+    for (i = 0; i < SP->opaque->n_windows; i++)
+        if (SP->opaque->window_list[i]->_parent == win)
+            return TRUE;
+
+    return FALSE;
+}
+
+/* For a sparse pad, when line y is to be filled entirely with 'blank'
+   and the shared blank line already holds that, frees the line's own
+   storage and points it back at the shared line. Returns TRUE if so,
+   in which case the caller has nothing left to write. */
+
+bool PDC_release_line(WINDOW *win, const int y, const chtype blank)
+{
+    chtype *shared;
+
+    assert( win);
+    assert( y >= 0 && y < win->_maxy);
+
+    if (!(win->_flags & _SPARSE))
+        return FALSE;
+
+    shared = _SPARSE_BLANK_LINE(win);
+
+    if (shared[0] != blank)
+        return FALSE;
+
+    if (win->_y[y] != shared)
+    {
+        /* sub-pads may point into this line's storage */
+
+        if (_has_subwindows(win))
+            return FALSE;
+
+        free(win->_y[y]);
+        win->_y[y] = shared;
+    }
+
+    return TRUE;
+}
+
+static WINDOW *_newpad(int nlines, int ncols, bool sparse)
+{
+    WINDOW *win;
 
     assert( nlines > 0 && ncols > 0);
     win = PDC_makenew(nlines, ncols, 0, 0);
     if (win)
-        win = PDC_makelines(win);
+        win = (sparse ? PDC_makesparselines(win) : PDC_makelines(win));
 
     if (!win)
         return (WINDOW *)NULL;
 
-    werase(win);
+    if (!sparse)               /* sparse lines start out blank */
+        werase(win);
 
-    win->_flags = _PAD;
+    win->_flags |= _PAD;
 
     /* save default values in case pechochar() is the first call to
        prefresh(). */
@@ -112,6 +288,405 @@ WINDOW *newpad(int nlines, int ncols)
     return win;
 }
 
+WINDOW *newpad(int nlines, int ncols)
+{
+    PDC_LOG(("newpad() - called: lines=%d cols=%d\n", nlines, ncols));
+
+    return _newpad(nlines, ncols, FALSE);
+}
+
+WINDOW *newpad_sparse(int nlines, int ncols)
+{
+    PDC_LOG(("newpad_sparse() - called: lines=%d cols=%d\n",
+             nlines, ncols));
+
+    return _newpad(nlines, ncols, TRUE);
+}
+
+/* A file pad is an ordinary pad whose lines serve as a cache of decoded
+   lines of the file, reused least recently used first. Lines are found
+   through the offset of every FILE_PAD_STEP'th line, recorded as the
+   file is indexed, FILE_PAD_CHUNK bytes at a time; a line past the
+   indexed part is found by indexing up to it. */
+
+#define FILE_PAD_STEP      64
+#define FILE_PAD_CHUNK     (1L << 20)
+
+struct _pdc_file_pad
+{
+    WINDOW *win;
+    const char *data;
+    size_t size;
+    bool mapped;
+    size_t *checkpoints;       /* offset of every FILE_PAD_STEP'th line */
+    int n_checkpoints, checkpoints_allocated;
+    int n_lines;               /* lines found so far */
+    size_t scan_pos;           /* where indexing resumes */
+    bool complete;
+    int n_slots, slot_cols;
+    int *slot_line;            /* file line held in each pad line, or -1 */
+    unsigned long *slot_used, clock;
+    struct _pdc_file_pad *next;
+};
+
+static bool _map_file(struct _pdc_file_pad *fp, const char *filename)
+{
+#ifdef USE_MMAP
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0)
+        return FALSE;
+
+    if (fstat(fd, &st) || (off_t)(size_t)st.st_size != st.st_size)
+    {
+        close(fd);
+        return FALSE;
+    }
+
+    fp->size = (size_t)st.st_size;
+    if (fp->size)
+    {
+        void *addr = mmap(NULL, fp->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            return FALSE;
+        }
+        fp->data = (const char *)addr;
+        fp->mapped = TRUE;
+    }
+
+    close(fd);       /* the mapping outlives the descriptor */
+    return TRUE;
+#else
+    FILE *ifile = fopen(filename, "rb");
+    char *buff = NULL;
+    long len = -1L;
+
+    if (!ifile)
+        return FALSE;
+
+    if (!fseek(ifile, 0L, SEEK_END))
+        len = ftell(ifile);
+
+    if (len >= 0L && !fseek(ifile, 0L, SEEK_SET))
+        buff = (char *)malloc(len ? (size_t)len : 1);
+
+    if (buff && fread(buff, 1, (size_t)len, ifile) != (size_t)len)
+    {
+        free(buff);
+        buff = NULL;
+    }
+
+    fclose(ifile);
+    fp->data = buff;
+    fp->size = (size_t)len;
+    return (buff != NULL);
+#endif
+}
+
+static void _free_file_pad_data(struct _pdc_file_pad *fp)
+{
+#ifdef USE_MMAP
+    if (fp->mapped)
+        munmap((void *)fp->data, fp->size);
+#else
+    free((void *)fp->data);
+#endif
+    free(fp->checkpoints);
+    free(fp->slot_line);
+    free(fp->slot_used);
+    free(fp);
+}
+
+static struct _pdc_file_pad *_find_file_pad(const WINDOW *win)
+{
+    struct _pdc_file_pad *fp = SP->opaque->file_pads;
+
+    while (fp && fp->win != win)
+        fp = fp->next;
+
+    return fp;
+}
+
+/* Indexes up to n_bytes more of the file */
+
+static void _index_file(struct _pdc_file_pad *fp, size_t n_bytes)
+{
+    const size_t end = (n_bytes < fp->size - fp->scan_pos ?
+                        fp->scan_pos + n_bytes : fp->size);
+    size_t pos = fp->scan_pos;
+
+    while (pos < end)
+    {
+        const char *eol = (const char *)memchr(fp->data + pos, '\n',
+                                               end - pos);
+
+        if (!eol)
+            break;
+
+        pos = eol - fp->data + 1;
+        if (fp->n_lines == INT_MAX - 1)     /* can't count any further */
+        {
+            fp->complete = TRUE;
+            return;
+        }
+
+        fp->n_lines++;
+        if (!(fp->n_lines % FILE_PAD_STEP))
+        {
+            if (fp->n_checkpoints == fp->checkpoints_allocated)
+            {
+                const int new_size = fp->checkpoints_allocated * 2;
+                size_t *new_checkpoints = (size_t *)realloc(fp->checkpoints,
+                                              new_size * sizeof(size_t));
+
+                if (!new_checkpoints)       /* show what's been indexed */
+                {
+                    fp->complete = TRUE;
+                    return;
+                }
+                fp->checkpoints = new_checkpoints;
+                fp->checkpoints_allocated = new_size;
+            }
+            fp->checkpoints[fp->n_checkpoints++] = pos;
+        }
+    }
+
+    fp->scan_pos = end;
+    if (end == fp->size)
+    {
+        fp->complete = TRUE;
+        if (fp->size && fp->data[fp->size - 1] != '\n')
+            fp->n_lines++;                  /* unterminated last line */
+    }
+}
+
+#ifdef USING_COMBINING_CHARACTER_SCHEME
+   int PDC_find_combined_char_idx( const cchar_t root, const cchar_t added);
+
+   #define DUMMY_CHAR_NEXT_TO_FULLWIDTH 0x110000
+   #define COMBINED_CHAR_START          0x110001
+#endif
+
+/* Lays out the line starting at offset pos into ncols cells, much as
+   waddch() would: fullwidth characters take two cells, and combining
+   marks are merged into the character before them */
+
+static void _decode_line(const struct _pdc_file_pad *fp, chtype *dest,
+                         int ncols, size_t pos)
+{
+    const chtype attr = fp->win->_bkgd & A_ATTRIBUTES;
+    int x = 0;
+
+    while (x < ncols && pos < fp->size && fp->data[pos] != '\n')
+    {
+        const unsigned char c = (unsigned char)fp->data[pos++];
+
+        if (c == '\t')
+        {
+            const int tab_end = ((x / TABSIZE) + 1) * TABSIZE;
+
+            while (x < tab_end && x < ncols)
+                dest[x++] = ' ' | attr;
+        }
+        else if (c == '\r' && (pos == fp->size || fp->data[pos] == '\n'))
+            ;                               /* CR/LF line ending */
+        else if (c < ' ' || c == 0x7f)
+        {
+            dest[x++] = '^' | attr;
+            if (x < ncols)
+                dest[x++] = (chtype)(c ^ 0x40) | attr;
+        }
+#ifdef PDC_WIDE
+        else if (c >= 0x80)
+        {
+            wchar_t wc;
+            const int len = PDC_mbtowc(&wc, fp->data + pos - 1,
+                                       fp->size - pos + 1);
+            int width;
+
+            if (len > 0)
+                pos += len - 1;
+            else
+                wc = '?';
+            width = PDC_wcwidth((int32_t)wc);
+
+            if (!width)                 /* combining mark: joins the */
+            {                           /* character to its left */
+# ifdef USING_COMBINING_CHARACTER_SCHEME
+                int root = x - 1;
+
+                if (root > 0 && (dest[root] & A_CHARTEXT)
+                                 == DUMMY_CHAR_NEXT_TO_FULLWIDTH)
+                    root--;
+                if (root >= 0)
+                    dest[root] = (COMBINED_CHAR_START
+                          + PDC_find_combined_char_idx(
+                                dest[root] & A_CHARTEXT, (cchar_t)wc))
+                          | (dest[root] & A_ATTRIBUTES);
+# endif
+            }
+            else if (width == 2 && x == ncols - 1)
+                dest[x++] = fp->win->_bkgd;     /* no room for both halves */
+            else
+            {
+                dest[x++] = (chtype)wc | attr;
+# ifdef USING_COMBINING_CHARACTER_SCHEME
+                if (width == 2)
+                    dest[x++] = DUMMY_CHAR_NEXT_TO_FULLWIDTH | attr;
+# endif
+            }
+        }
+#endif
+        else
+            dest[x++] = (chtype)c | attr;
+    }
+
+    while (x < ncols)
+        dest[x++] = fp->win->_bkgd;
+}
+
+/* Returns the cells of line 'line' of the file, decoding it into the
+   least recently used pad line if it isn't already in one */
+
+static const chtype *_file_pad_line(struct _pdc_file_pad *fp, int line)
+{
+    WINDOW *win = fp->win;
+    const int n_slots = min(fp->n_slots, win->_maxy);
+    int i, slot = 0;
+    size_t pos;
+
+    if (fp->slot_cols != win->_maxx)        /* pad was resized */
+    {
+        for (i = 0; i < fp->n_slots; i++)
+            fp->slot_line[i] = -1;
+        fp->slot_cols = win->_maxx;
+    }
+
+    for (i = 0; i < n_slots; i++)
+    {
+        if (fp->slot_line[i] == line)
+        {
+            fp->slot_used[i] = ++fp->clock;
+            return win->_y[i];
+        }
+        if (fp->slot_used[i] < fp->slot_used[slot])
+            slot = i;
+    }
+
+    while (!fp->complete && fp->n_lines < line)
+        _index_file(fp, FILE_PAD_CHUNK);
+
+    if (line < fp->n_lines || !fp->complete)
+    {
+        const char *data = fp->data;
+
+        pos = fp->checkpoints[line / FILE_PAD_STEP];
+        for (i = line % FILE_PAD_STEP; i; i--)
+            pos = (const char *)memchr(data + pos, '\n', fp->size - pos)
+                           - data + 1;
+    }
+    else
+        pos = fp->size;                     /* past the end:  blank */
+
+    _decode_line(fp, win->_y[slot], win->_maxx, pos);
+    fp->slot_line[slot] = line;
+    fp->slot_used[slot] = ++fp->clock;
+
+    return win->_y[slot];
+}
+
+WINDOW *newpad_file(const char *filename, int ncols)
+{
+    struct _pdc_file_pad *fp;
+    WINDOW *win = NULL;
+    int i;
+
+    PDC_LOG(("newpad_file() - called: file=%s cols=%d\n",
+             filename ? filename : "(null)", ncols));
+
+    assert( filename);
+    if (!filename || ncols < 1)
+        return (WINDOW *)NULL;
+
+    fp = (struct _pdc_file_pad *)calloc(1, sizeof(struct _pdc_file_pad));
+    if (!fp)
+        return (WINDOW *)NULL;
+
+    fp->n_slots = max(2 * LINES, 16);
+    fp->checkpoints_allocated = 64;
+    fp->checkpoints = (size_t *)malloc(fp->checkpoints_allocated
+                                       * sizeof(size_t));
+    fp->slot_line = (int *)malloc(fp->n_slots * sizeof(int));
+    fp->slot_used = (unsigned long *)calloc(fp->n_slots,
+                                            sizeof(unsigned long));
+
+    if (!fp->checkpoints || !fp->slot_line || !fp->slot_used
+                || !_map_file(fp, filename)
+                || !(win = _newpad(fp->n_slots, ncols, FALSE)))
+    {
+        _free_file_pad_data(fp);
+        return (WINDOW *)NULL;
+    }
+
+    fp->checkpoints[fp->n_checkpoints++] = 0;
+    if (!fp->size)
+        fp->complete = TRUE;
+
+    for (i = 0; i < fp->n_slots; i++)
+        fp->slot_line[i] = -1;
+    fp->slot_cols = ncols;
+
+    fp->win = win;
+    fp->next = SP->opaque->file_pads;
+    SP->opaque->file_pads = fp;
+
+    win->_flags |= _FILEPAD;
+    win->_leaveit = TRUE;       /* pad lines aren't file lines */
+
+    return win;
+}
+
+void PDC_free_file_pad(WINDOW *win)
+{
+    struct _pdc_file_pad **link = &SP->opaque->file_pads;
+
+    while (*link && (*link)->win != win)
+        link = &(*link)->next;
+
+    assert( *link);
+    if (*link)
+    {
+        struct _pdc_file_pad *fp = *link;
+
+        *link = fp->next;
+        _free_file_pad_data(fp);
+    }
+}
+
+int file_pad_lines(WINDOW *pad, bool *complete)
+{
+    struct _pdc_file_pad *fp;
+
+    PDC_LOG(("file_pad_lines() - called\n"));
+
+    assert( pad);
+    if (!pad || !(pad->_flags & _FILEPAD))
+        return ERR;
+
+    fp = _find_file_pad(pad);
+    if (!fp->complete)
+        _index_file(fp, FILE_PAD_CHUNK);
+
+    if (complete)
+        *complete = fp->complete;
+
+    return fp->n_lines;
+}
+
 WINDOW *subpad(WINDOW *orig, int nlines, int ncols, int begy, int begx)
 {
     WINDOW *win;
@@ -121,7 +696,7 @@ WINDOW *subpad(WINDOW *orig, int nlines, int ncols, int begy, int begx)
              nlines, ncols, begy, begx));
 
     assert( orig);
-    if (!orig || !(orig->_flags & _PAD))
+    if (!orig || !(orig->_flags & _PAD) || (orig->_flags & _FILEPAD))
         return (WINDOW *)NULL;
 
     /* make sure window fits inside the original one */
@@ -137,6 +712,13 @@ WINDOW *subpad(WINDOW *orig, int nlines, int ncols, int begy, int begx)
     if (!ncols)
         ncols = orig->_maxx - begx;
 
+    /* the sub-pad will point into these lines, so they can't stay
+       shared */
+
+    for (i = 0; i < nlines; i++)
+        if (!PDC_writable_line(orig, begy + i))
+            return (WINDOW *)NULL;
+
     assert( nlines > 0 && ncols > 0);
     win = PDC_makenew(nlines, ncols, begy, begx);
     if (!win)
@@ -183,9 +765,12 @@ int prefresh(WINDOW *win, int py, int px, int sy1, int sx1, int sy2, int sx2)
 
 int pnoutrefresh(WINDOW *w, int py, int px, int sy1, int sx1, int sy2, int sx2)
 {
+    struct _pdc_file_pad *fp = NULL;
     int num_cols;
     int sline;
     int pline;
+    int pad_stride, scr_stride;
+    uint32_t *pad_rgb, *scr_rgb;
 
     PDC_LOG(("pnoutrefresh() - called\n"));
 
@@ -205,6 +790,12 @@ int pnoutrefresh(WINDOW *w, int py, int px, int sy1, int sx1, int sy2, int sx2)
         (sy2 < sy1) || (sx2 < sx1))
         return ERR;
 
+    if (w->_flags & _FILEPAD)
+        fp = _find_file_pad(w);
+
+    pad_rgb = PDC_rgb_plane(w, &pad_stride, FALSE);
+    scr_rgb = PDC_rgb_plane(curscr, &scr_stride, pad_rgb != NULL);
+
     sline = sy1;
     pline = py;
 
@@ -212,11 +803,35 @@ int pnoutrefresh(WINDOW *w, int py, int px, int sy1, int sx1, int sy2, int sx2)
 
     while (sline <= sy2)
     {
-        if (pline < w->_maxy)
+        if (fp)
+        {
+            memcpy(curscr->_y[sline] + sx1, _file_pad_line(fp, pline) + px,
+                   num_cols * sizeof(chtype));
+
+            /* file text has no RGB values; clear whatever was there */
+
+            if (scr_rgb)
+                memset(scr_rgb + sline * scr_stride + sx1 * 2, 0xff,
+                       num_cols * 2 * sizeof(uint32_t));
+
+            PDC_mark_cells_as_changed( curscr, sline, sx1, sx2);
+        }
+        else if (pline < w->_maxy)
         {
             memcpy(curscr->_y[sline] + sx1, w->_y[pline] + px,
                    num_cols * sizeof(chtype));
 
+            if (scr_rgb)
+            {
+                uint32_t *drgb = scr_rgb + sline * scr_stride + sx1 * 2;
+
+                if (pad_rgb)
+                    memcpy(drgb, pad_rgb + pline * pad_stride + px * 2,
+                           num_cols * 2 * sizeof(uint32_t));
+                else
+                    memset(drgb, 0xff, num_cols * 2 * sizeof(uint32_t));
+            }
+
             PDC_mark_cells_as_changed( curscr, sline, sx1, sx2);
             PDC_set_changed_cells_range( w, pline, _NO_CHANGE, _NO_CHANGE);
         }
@@ -225,6 +840,11 @@ int pnoutrefresh(WINDOW *w, int py, int px, int sy1, int sx1, int sy2, int sx2)
         pline++;
     }
 
+    /* with the view drawn, index a little more of the file */
+
+    if (fp && !fp->complete)
+        _index_file(fp, FILE_PAD_CHUNK);
+
     if (w->_clear)
     {
         w->_clear = FALSE;
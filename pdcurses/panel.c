@@ -93,8 +93,9 @@ panel
    contents of the panel are unchanged.
 
    update_panels() refreshes the virtual screen to reflect the depth
-   relationships between the panels in the deck. The user must use
-   doupdate() to refresh the physical screen.
+   relationships between the panels in the deck. Only the changed cells
+   of each panel that are not hidden by panels above it are copied. The
+   user must use doupdate() to refresh the physical screen.
 
 ### Return Value
 
@@ -130,14 +131,6 @@ panel
 #include <panel.h>
 #include <stdlib.h>
 
-typedef struct panelobs PANELOBS;
-
-struct panelobs
-{
-    struct panelobs *above;
-    struct panel *pan;
-};
-
 struct panel
 {
     WINDOW *win;
@@ -148,13 +141,25 @@ struct panel
     struct panel *below;
     struct panel *above;
     const void *user;
-    struct panelobs *obscure;
 };
 
 static PANEL *_bottom_panel = (PANEL *)0;
 static PANEL *_top_panel = (PANEL *)0;
 static PANEL _stdscr_pseudo_panel;
 
+/* The ownership map records, for each cell of curscr, the topmost
+   panel in the deck covering it -- the stdscr pseudo-panel where no
+   panel does, and NULL outside stdscr (e.g. ripped-off lines). It's
+   patched for just the affected rectangle whenever the deck changes,
+   and any cell whose owner changes is marked as changed in its new
+   owner's window. update_panels() can then copy only the visible,
+   changed cells of each panel, without touching the panels above. */
+
+static PANEL **_owner_map = (PANEL **)0;
+static PANEL **_owner_scratch = (PANEL **)0;
+static int _owner_lines = 0;
+static int _owner_cols = 0;
+
 #ifdef PANEL_DEBUG
 
 static void dPanel(char *text, PANEL *pan)
@@ -199,123 +204,215 @@ static void Touchpan(PANEL *pan)
     touchwin(pan->win);
 }
 
-static void Touchline(PANEL *pan, int start, int count)
-{
-    char s80[80];
-
-    sprintf(s80, "Touchline s=%d c=%d", start, count);
-    dPanel(s80, pan);
-    touchline(pan->win, start, count);
-}
-
 #else   /* PANEL_DEBUG */
 
 #define dPanel(text, pan)
 #define dStack(fmt, num, pan)
 #define Wnoutrefresh(pan) wnoutrefresh((pan)->win)
 #define Touchpan(pan) touchwin((pan)->win)
-#define Touchline(pan, start, count) touchline((pan)->win, start, count)
 
 #endif  /* PANEL_DEBUG */
 
-static bool _panels_overlapped(PANEL *pan1, PANEL *pan2)
+static void _set_panel_extent(PANEL *pan, WINDOW *win)
 {
-    assert( pan1);
-    assert( pan2);
-    if (!pan1 || !pan2)
-        return FALSE;
+    int maxy, maxx;
 
-    return ((pan1->wstarty >= pan2->wstarty && pan1->wstarty < pan2->wendy)
-         || (pan2->wstarty >= pan1->wstarty && pan2->wstarty < pan1->wendy))
-        && ((pan1->wstartx >= pan2->wstartx && pan1->wstartx < pan2->wendx)
-         || (pan2->wstartx >= pan1->wstartx && pan2->wstartx < pan1->wendx));
+    getbegyx(win, pan->wstarty, pan->wstartx);
+    getmaxyx(win, maxy, maxx);
+    pan->wendy = pan->wstarty + maxy;
+    pan->wendx = pan->wstartx + maxx;
 }
 
-static void _free_obscure(PANEL *pan)
+static void _free_owner_map(void)
 {
-    PANELOBS *tobs = pan->obscure;  /* "this" one */
-    PANELOBS *nobs;                 /* "next" one */
+    free(_owner_map);
+    free(_owner_scratch);
+    _owner_map = _owner_scratch = (PANEL **)0;
+    _owner_lines = _owner_cols = 0;
+}
+
+/* Recompute the owners of the cells in the given rectangle (in screen
+   coordinates, end exclusive), and mark every cell whose owner changed
+   as changed in the window of the new owner */
+
+static void _recompose(int starty, int startx, int endy, int endx)
+{
+    PANEL *pan;
+    int y, x;
 
-    while (tobs)
+    starty = max(starty, 0);
+    startx = max(startx, 0);
+    endy = min(endy, _owner_lines);
+    endx = min(endx, _owner_cols);
+
+    for (y = starty; y < endy; y++)
     {
-        nobs = tobs->above;
-        free((char *)tobs);
-        tobs = nobs;
+        PANEL **row = _owner_map + y * _owner_cols;
+        PANEL **scratch = _owner_scratch;
+
+        pan = &_stdscr_pseudo_panel;
+
+        if (y >= pan->wstarty && y < pan->wendy)
+            for (x = startx; x < endx; x++)
+                scratch[x] = (x >= pan->wstartx && x < pan->wendx) ?
+                             pan : (PANEL *)0;
+        else
+            for (x = startx; x < endx; x++)
+                scratch[x] = (PANEL *)0;
+
+        for (pan = _bottom_panel; pan; pan = pan->above)
+            if (y >= pan->wstarty && y < pan->wendy)
+            {
+                int x1 = min(pan->wendx, endx);
+
+                for (x = max(pan->wstartx, startx); x < x1; x++)
+                    scratch[x] = pan;
+            }
+
+        x = startx;
+
+        while (x < endx)
+        {
+            int run_start;
+
+            if (row[x] == scratch[x])
+            {
+                x++;
+                continue;
+            }
+
+            pan = scratch[x];
+            run_start = x;
+
+            while (x < endx && row[x] != scratch[x] && scratch[x] == pan)
+            {
+                row[x] = pan;
+                x++;
+            }
+
+            if (pan)
+                PDC_mark_cells_as_changed(pan->win, y - pan->wstarty,
+                                          run_start - pan->wstartx,
+                                          x - 1 - pan->wstartx);
+        }
     }
-    pan->obscure = (PANELOBS *)0;
 }
 
-static void _override(PANEL *pan, int show)
+/* (Re)allocate the ownership map to match curscr, starting from the
+   state of an empty deck, then lay the deck over it */
+
+static bool _build_owner_map(void)
 {
-    int y;
-    PANEL *pan2;
-    PANELOBS *tobs = pan->obscure;      /* "this" one */
+    PANEL *pan = &_stdscr_pseudo_panel;
+    int y, x;
 
-    if (show == 1)
-        Touchpan(pan);
-    else if (!show)
-    {
-        Touchpan(pan);
-        Touchpan(&_stdscr_pseudo_panel);
-    }
-    else if (show == -1)
-        while (tobs && (tobs->pan != pan))
-            tobs = tobs->above;
+    _free_owner_map();
+
+    _stdscr_pseudo_panel.win = stdscr;
+    _set_panel_extent(pan, stdscr);
 
-    while (tobs)
+    _owner_map = malloc(curscr->_maxy * curscr->_maxx * sizeof(PANEL *));
+    _owner_scratch = malloc(curscr->_maxx * sizeof(PANEL *));
+
+    if (!_owner_map || !_owner_scratch)
     {
-        if ((pan2 = tobs->pan) != pan)
-            for (y = pan->wstarty; y < pan->wendy; y++)
-                if ((y >= pan2->wstarty) && (y < pan2->wendy) &&
-                   ((is_linetouched(pan->win, y - pan->wstarty)) ||
-                    (is_linetouched(stdscr, y))))
-                    Touchline(pan2, y - pan2->wstarty, 1);
-
-        tobs = tobs->above;
+        _free_owner_map();
+        return FALSE;
     }
+
+    _owner_lines = curscr->_maxy;
+    _owner_cols = curscr->_maxx;
+
+    for (y = 0; y < _owner_lines; y++)
+        for (x = 0; x < _owner_cols; x++)
+            _owner_map[y * _owner_cols + x] =
+                (y >= pan->wstarty && y < pan->wendy &&
+                 x >= pan->wstartx && x < pan->wendx) ? pan : (PANEL *)0;
+
+    _recompose(0, 0, _owner_lines, _owner_cols);
+
+    return TRUE;
 }
 
-static void _calculate_obscure(void)
+/* make sure the map is current after a screen resize */
+
+static bool _owner_map_ready(void)
 {
-    PANEL *pan, *pan2;
-    PANELOBS *tobs;     /* "this" one */
-    PANELOBS *lobs;     /* last one */
+    if (_owner_map && _owner_lines == curscr->_maxy &&
+        _owner_cols == curscr->_maxx && _stdscr_pseudo_panel.win == stdscr)
+        return TRUE;
 
-    pan = _bottom_panel;
+    return _build_owner_map();
+}
 
-    while (pan)
+/* the deck changed within the given panel's rectangle */
+
+static void _deck_changed(PANEL *pan)
+{
+    if (!_bottom_panel)
     {
-        if (pan->obscure)
-            _free_obscure(pan);
+        /* deck is now empty; give the area back to stdscr */
 
-        lobs = (PANELOBS *)0;
-        pan2 = _bottom_panel;
+        if (_owner_map)
+            touchwin(stdscr);
 
-        while (pan2)
-        {
-            if (_panels_overlapped(pan, pan2))
-            {
-                if ((tobs = malloc(sizeof(PANELOBS))) == NULL)
-                    return;
+        _free_owner_map();
+    }
+    else if (_owner_map_ready())
+        _recompose(pan->wstarty, pan->wstartx, pan->wendy, pan->wendx);
+}
 
-                tobs->pan = pan2;
-                dPanel("obscured", pan2);
-                tobs->above = (PANELOBS *)0;
+/* like wnoutrefresh(), but only copies the cells this panel owns */
 
-                if (lobs)
-                    lobs->above = tobs;
-                else
-                    pan->obscure = tobs;
+static void _panel_wnoutrefresh(PANEL *pan)
+{
+    WINDOW *win = pan->win;
+    int i, y, win_stride, scr_stride;
+    uint32_t *win_rgb, *scr_rgb;
 
-                lobs  = tobs;
-            }
+    dPanel("wnoutrefresh", pan);
+
+    win_rgb = PDC_rgb_plane(win, &win_stride, FALSE);
+    scr_rgb = PDC_rgb_plane(curscr, &scr_stride, win_rgb != NULL);
 
-            pan2 = pan2->above;
+    for (i = 0, y = pan->wstarty; i < win->_maxy && y < _owner_lines;
+         i++, y++)
+    {
+        if (win->_firstch[i] != _NO_CHANGE && y >= 0)
+        {
+            PANEL **owner = _owner_map + y * _owner_cols + pan->wstartx;
+            chtype *src = win->_y[i];
+            chtype *dest = curscr->_y[y] + pan->wstartx;
+            const uint32_t *srgb = (win_rgb ? win_rgb + i * win_stride : NULL);
+            uint32_t *drgb = (scr_rgb ? scr_rgb + y * scr_stride
+                                        + pan->wstartx * 2 : NULL);
+            int first = max(win->_firstch[i], -pan->wstartx);
+            int last = min(win->_lastch[i], _owner_cols - pan->wstartx - 1);
+            int x, lo = last + 1, hi = -1;
+
+            for (x = first; x <= last; x++)
+                if (owner[x] == pan &&
+                    !PDC_SAME_CELL(src, dest, srgb, drgb, x))
+                {
+                    dest[x] = src[x];
+                    PDC_copy_rgb(drgb, srgb, x, x);
+                    if (lo > x)
+                        lo = x;
+                    hi = x;
+                }
+
+            if (lo <= hi)
+                PDC_mark_cells_as_changed(curscr, y, lo + pan->wstartx,
+                                          hi + pan->wstartx);
         }
 
-        _override(pan, 1);
-        pan = pan->above;
+        PDC_set_changed_cells_range(win, i, _NO_CHANGE, _NO_CHANGE);
     }
+
+    /* nothing is left to copy; this just handles the cursor and the
+       clear flag the usual way */
+
+    wnoutrefresh(win);
 }
 
 /* check to see if panel is in the stack */
@@ -358,7 +455,7 @@ static void _panel_link_top(PANEL *pan)
     if (!_bottom_panel)
         _bottom_panel = pan;
 
-    _calculate_obscure();
+    _deck_changed(pan);
     dStack("<lt%d>", 9, pan);
 }
 
@@ -385,7 +482,7 @@ static void _panel_link_bottom(PANEL *pan)
     if (!_top_panel)
         _top_panel = pan;
 
-    _calculate_obscure();
+    _deck_changed(pan);
     dStack("<lb%d>", 9, pan);
 }
 
@@ -399,9 +496,6 @@ static void _panel_unlink(PANEL *pan)
     if (!_panel_is_linked(pan))
         return;
 #endif
-    _override(pan, 0);
-    _free_obscure(pan);
-
     prev = pan->below;
     next = pan->above;
 
@@ -422,12 +516,11 @@ static void _panel_unlink(PANEL *pan)
     if (pan == _top_panel)
         _top_panel = prev;
 
-    _calculate_obscure();
-
     pan->above = (PANEL *)0;
     pan->below = (PANEL *)0;
-    dStack("<u%d>", 9, pan);
 
+    _deck_changed(pan);
+    dStack("<u%d>", 9, pan);
 }
 
 /************************************************************************
@@ -486,29 +579,30 @@ int hide_panel(PANEL *pan)
 
 int move_panel(PANEL *pan, int starty, int startx)
 {
-    WINDOW *win;
-    int maxy, maxx, rval;
+    PANEL old_extent;
+    int rval;
 
     assert( pan);
     if (!pan)
         return ERR;
 
-    if (_panel_is_linked(pan))
-        _override(pan, 0);
-
-    win = pan->win;
+    old_extent = *pan;
 
-    rval = mvwin(win, starty, startx);
+    rval = mvwin(pan->win, starty, startx);
     if( rval != ERR)
     {
-        getbegyx(win, pan->wstarty, pan->wstartx);
-        getmaxyx(win, maxy, maxx);
-        pan->wendy = pan->wstarty + maxy;
-        pan->wendx = pan->wstartx + maxx;
-    }
+        _set_panel_extent(pan, pan->win);
 
-    if (_panel_is_linked(pan))
-        _calculate_obscure();
+        if (_panel_is_linked(pan))
+        {
+            /* the window's contents have shifted under cells it may
+               still own, so redraw all of it */
+
+            Touchpan(pan);
+            _deck_changed(&old_extent);
+            _deck_changed(pan);
+        }
+    }
 
     return rval;
 }
@@ -526,31 +620,21 @@ PANEL *new_panel(WINDOW *win)
     if (!_stdscr_pseudo_panel.win)
     {
         _stdscr_pseudo_panel.win = stdscr;
-        _stdscr_pseudo_panel.wstarty = 0;
-        _stdscr_pseudo_panel.wstartx = 0;
-        _stdscr_pseudo_panel.wendy = LINES;
-        _stdscr_pseudo_panel.wendx = COLS;
+        _set_panel_extent(&_stdscr_pseudo_panel, stdscr);
         _stdscr_pseudo_panel.user = "stdscr";
-        _stdscr_pseudo_panel.obscure = (PANELOBS *)0;
     }
 
     if (pan)
     {
-        int maxy, maxx;
-
         pan->win = win;
         pan->above = (PANEL *)0;
         pan->below = (PANEL *)0;
-        getbegyx(win, pan->wstarty, pan->wstartx);
-        getmaxyx(win, maxy, maxx);
-        pan->wendy = pan->wstarty + maxy;
-        pan->wendx = pan->wstartx + maxx;
+        _set_panel_extent(pan, win);
 #ifdef PANEL_DEBUG
         pan->user = "new";
 #else
         pan->user = (char *)0;
 #endif
-        pan->obscure = (PANELOBS *)0;
         show_panel(pan);
     }
 
@@ -607,24 +691,24 @@ WINDOW *panel_window(const PANEL *pan)
 
 int replace_panel(PANEL *pan, WINDOW *win)
 {
-    int maxy, maxx;
+    PANEL old_extent;
 
     assert( pan);
     assert( win);
     if (!pan)
         return ERR;
 
-    if (_panel_is_linked(pan))
-        _override(pan, 0);
+    old_extent = *pan;
 
     pan->win = win;
-    getbegyx(win, pan->wstarty, pan->wstartx);
-    getmaxyx(win, maxy, maxx);
-    pan->wendy = pan->wstarty + maxy;
-    pan->wendx = pan->wstartx + maxx;
+    _set_panel_extent(pan, win);
 
     if (_panel_is_linked(pan))
-        _calculate_obscure();
+    {
+        Touchpan(pan);
+        _deck_changed(&old_extent);
+        _deck_changed(pan);
+    }
 
     return OK;
 }
@@ -668,23 +752,40 @@ void update_panels(void)
 
     PDC_LOG(("update_panels() - called\n"));
 
-    pan = _bottom_panel;
+    if (!_bottom_panel)
+    {
+        if (is_wintouched(stdscr))
+            wnoutrefresh(stdscr);
 
-    while (pan)
+        return;
+    }
+
+    if (!_owner_map_ready())
     {
-        _override(pan, -1);
-        pan = pan->above;
+        /* out of memory for the map; fall back to repainting the
+           whole deck, bottom to top */
+
+        touchwin(stdscr);
+        wnoutrefresh(stdscr);
+
+        for (pan = _bottom_panel; pan; pan = pan->above)
+        {
+            Touchpan(pan);
+            Wnoutrefresh(pan);
+        }
+
+        return;
     }
 
     if (is_wintouched(stdscr))
-        Wnoutrefresh(&_stdscr_pseudo_panel);
+        _panel_wnoutrefresh(&_stdscr_pseudo_panel);
 
     pan = _bottom_panel;
 
     while (pan)
     {
         if (is_wintouched(pan->win) || !pan->above)
-            Wnoutrefresh(pan);
+            _panel_wnoutrefresh(pan);
 
         pan = pan->above;
     }
@@ -56,6 +56,7 @@ refresh
 
 **man-end****************************************************************/
 
+#include <stdlib.h>
 #include <string.h>
 
 static void _normalize_cursor( WINDOW *win)
@@ -72,10 +73,35 @@ static void _normalize_cursor( WINDOW *win)
 
 int PDC_pnoutrefresh_with_stored_params( WINDOW *pad);       /* pad.c */
 
+/* A missing plane reads as PDC_RGB_NONE;  see PDC_SAME_CELL(). */
+
+bool PDC_same_rgb(const uint32_t *a, const uint32_t *b)
+{
+    if (a && b)
+        return (a[0] == b[0] && a[1] == b[1]);
+    a = (a ? a : b);
+    return (!a || (a[0] == PDC_RGB_NONE && a[1] == PDC_RGB_NONE));
+}
+
+/* Copies plane values for cells first...last to 'drgb' (if there is
+one),  from 'srgb' or as PDC_RGB_NONE if the source has no plane. */
+
+void PDC_copy_rgb(uint32_t *drgb, const uint32_t *srgb,
+                  const int first, const int last)
+{
+    if (drgb && srgb)
+        memcpy(drgb + first * 2, srgb + first * 2,
+               (last - first + 1) * 2 * sizeof(uint32_t));
+    else if (drgb)
+        memset(drgb + first * 2, 0xff,
+               (last - first + 1) * 2 * sizeof(uint32_t));
+}
+
 int wnoutrefresh(WINDOW *win)
 {
     int begy, begx;     /* window's place on screen   */
-    int i, j;
+    int i, j, win_stride, scr_stride;
+    uint32_t *win_rgb, *scr_rgb;
 
     PDC_LOG(("wnoutrefresh() - called: win=%p\n", win));
 
@@ -87,6 +113,8 @@ int wnoutrefresh(WINDOW *win)
 
     begy = win->_begy;
     begx = win->_begx;
+    win_rgb = PDC_rgb_plane(win, &win_stride, FALSE);
+    scr_rgb = PDC_rgb_plane(curscr, &scr_stride, win_rgb != NULL);
 
     for (i = 0, j = begy; i < win->_maxy && j < curscr->_maxy; i++, j++)
     {
@@ -94,6 +122,9 @@ int wnoutrefresh(WINDOW *win)
         {
             chtype *src = win->_y[i];
             chtype *dest = curscr->_y[j] + begx;
+            const uint32_t *srgb = (win_rgb ? win_rgb + i * win_stride : NULL);
+            uint32_t *drgb = (scr_rgb ? scr_rgb + j * scr_stride + begx * 2
+                                      : NULL);
 
             int first = win->_firstch[i]; /* first changed */
             int last = win->_lastch[i];   /* last changed */
@@ -106,10 +137,12 @@ int wnoutrefresh(WINDOW *win)
             /* ignore areas on the outside that are marked as changed,
                but really aren't */
 
-            while (first <= last && src[first] == dest[first])
+            while (first <= last &&
+                   PDC_SAME_CELL(src, dest, srgb, drgb, first))
                 first++;
 
-            while (last >= first && src[last] == dest[last])
+            while (last >= first &&
+                   PDC_SAME_CELL(src, dest, srgb, drgb, last))
                 last--;
 
             /* if any have really changed... */
@@ -118,6 +151,7 @@ int wnoutrefresh(WINDOW *win)
             {
                 memcpy(dest + first, src + first,
                        (last - first + 1) * sizeof(chtype));
+                PDC_copy_rgb(drgb, srgb, first, last);
 
                 first += begx;
                 last += begx;
@@ -146,10 +180,235 @@ int wnoutrefresh(WINDOW *win)
     return OK;
 }
 
+#define _PAIR_BLOOM_BIT( ch)  \
+            PDC_PAIR_BLOOM_BIT( (int)(((ch) & A_COLOR) >> PDC_COLOR_SHIFT))
+
+/* Makes sure there's a pair Bloom filter for each line of the screen;
+   after a resize (or if there's no memory for them), lines are taken
+   to hold every pair. */
+
+static unsigned long *_line_pair_blooms(void)
+{
+    struct _opaque_screen_t *optr = SP->opaque;
+
+    if (optr->line_pair_blooms_lines != SP->lines)
+    {
+        unsigned long *blooms = (unsigned long *)realloc(
+                    optr->line_pair_blooms, SP->lines * sizeof(unsigned long));
+        int y;
+
+        if (!blooms)
+        {
+            free(optr->line_pair_blooms);
+            optr->line_pair_blooms_lines = 0;
+        }
+        else
+        {
+            for (y = 0; y < SP->lines; y++)
+                blooms[y] = ~0UL;
+            optr->line_pair_blooms_lines = SP->lines;
+        }
+        optr->line_pair_blooms = blooms;
+    }
+
+    return optr->line_pair_blooms;
+}
+
+/* For each line of SP->lastscr, blink_spans[2 * y] and [2 * y + 1]
+   bound the columns holding A_BLINK cells (first > last if there are
+   none). doupdate() keeps them current as it copies cells, so that the
+   platform's blink tick need only look within the spans, and can do
+   without a blink timer entirely when no line has blinking text. After
+   a resize, spans cover whole lines until the lines are redrawn. */
+
+static int *_blink_spans(void)
+{
+    struct _opaque_screen_t *optr = SP->opaque;
+
+    if (optr->blink_spans_lines != SP->lines)
+    {
+        int *spans = (int *)realloc(optr->blink_spans,
+                                    2 * SP->lines * sizeof(int));
+        int y;
+
+        if (!spans)
+        {
+            free(optr->blink_spans);
+            optr->blink_spans_lines = 0;
+        }
+        else
+        {
+            for (y = 0; y < SP->lines; y++)
+            {
+                spans[2 * y] = 0;
+                spans[2 * y + 1] = SP->cols - 1;
+            }
+            optr->blink_spans_lines = SP->lines;
+        }
+        optr->blink_spans = spans;
+        optr->n_blinking_lines = SP->lines;
+    }
+
+    return optr->blink_spans;
+}
+
+/* Cells first...last of line y have just been copied to SP->lastscr.
+   Outside that range, the old span still holds; within it, we look
+   for blinking cells afresh. The ends are then trimmed to actual
+   blinking cells, so a line whose blinking text has all been
+   overwritten ends up with an empty span. */
+
+static void _update_blink_span(int *spans, const int y, const int first,
+                               const int last)
+{
+    const chtype *line = SP->lastscr->_y[y];
+    int *span = spans + 2 * y;
+    const bool had_blink = (span[0] <= span[1]);
+    const int old_last = (span[1] < SP->cols ? span[1] : SP->cols - 1);
+    int new_first = SP->cols, new_last = -1, x;
+
+    if (had_blink)     /* (the screen may have narrowed since) */
+    {
+        if (span[0] < first)
+        {
+            new_first = span[0];
+            new_last = (old_last < first ? old_last : first - 1);
+        }
+        if (old_last > last)
+        {
+            if (new_first > last + 1)
+                new_first = (span[0] > last ? span[0] : last + 1);
+            new_last = old_last;
+        }
+    }
+
+    for (x = first; x <= last; x++)
+        if (line[x] & A_BLINK)
+        {
+            if (new_first > x)
+                new_first = x;
+            if (new_last < x)
+                new_last = x;
+        }
+
+    while (new_first <= new_last && !(line[new_first] & A_BLINK))
+        new_first++;
+    while (new_first <= new_last && !(line[new_last] & A_BLINK))
+        new_last--;
+
+    span[0] = new_first;
+    span[1] = new_last;
+    SP->opaque->n_blinking_lines += (new_first <= new_last) - had_blink;
+}
+
+int PDC_n_blinking_lines(void)
+{
+    if (!SP || !SP->opaque)
+        return 0;
+
+    return (SP->opaque->blink_spans ? SP->opaque->n_blinking_lines : SP->lines);
+}
+
+/* Called by the platform code on each blink tick, after flipping its
+   blink state: redraws each run of blinking cells. */
+
+void PDC_redraw_blinking_cells(void)
+{
+    const int *spans = _blink_spans();
+    int x, y;
+
+    for (y = 0; y < SP->lines; y++)
+    {
+        const chtype *line = curscr->_y[y];
+        int end = SP->cols - 1;
+
+        x = 0;
+        if (spans)
+        {
+            if (spans[2 * y] > spans[2 * y + 1])
+                continue;
+            x = spans[2 * y];
+            if (end > spans[2 * y + 1])
+                end = spans[2 * y + 1];
+        }
+
+        while (x <= end)
+            if (line[x] & A_BLINK)
+            {
+                const int x0 = x;
+
+                while (x <= end && (line[x] & A_BLINK))
+                    x++;
+                PDC_transform_line(y, x0, x - x0, line + x0);
+            }
+            else
+                x++;
+    }
+}
+
+/* Color pairs and attributes whose appearance has changed since the
+   last update (see color.c) are redrawn by spoiling SP->lastscr's copy
+   of each cell showing them, so that the cells no longer match curscr
+   and the loop in doupdate() sends them out again. Only lines whose
+   Bloom filter admits a changed pair are scanned (all lines, if
+   attributes changed); their filters are rebuilt on the way. */
+
+static void _spoil_cells_to_redraw(unsigned long *blooms)
+{
+    struct _opaque_screen_t *optr = SP->opaque;
+    const unsigned char *pair_bits = optr->pairs_to_redraw;
+    const int min_pair = optr->min_pair_to_redraw;
+    const int max_pair = optr->max_pair_to_redraw;
+    const chtype attrs = optr->attrs_to_redraw;
+    int x, y;
+
+    for (y = 0; y < SP->lines; y++)
+        if (attrs || !blooms || (blooms[y] & optr->pair_blooms_to_redraw))
+        {
+            chtype *src = curscr->_y[y];
+            chtype *dest = SP->lastscr->_y[y];
+            unsigned long bloom = 0;
+
+            for (x = 0; x < SP->cols; x++)
+            {
+                const int pair = (int)((dest[x] & A_COLOR) >> PDC_COLOR_SHIFT);
+
+                if ((dest[x] & attrs) || (pair >= min_pair && pair <= max_pair
+                           && (pair_bits[pair >> 3] & (1 << (pair & 7)))))
+                {
+                    dest[x] = ~src[x];
+                    PDC_mark_cell_as_changed(curscr, y, x);
+                }
+                else
+                    bloom |= PDC_PAIR_BLOOM_BIT(pair);
+            }
+
+            /* spoiled cells add their bits back as they're redrawn */
+
+            if (blooms)
+                blooms[y] = bloom;
+        }
+}
+
+static void _clear_cells_to_redraw(void)
+{
+    struct _opaque_screen_t *optr = SP->opaque;
+
+    if (optr->pair_blooms_to_redraw)
+        memset(optr->pairs_to_redraw + optr->min_pair_to_redraw / 8, 0,
+               optr->max_pair_to_redraw / 8 - optr->min_pair_to_redraw / 8 + 1);
+
+    optr->pair_blooms_to_redraw = 0;
+    optr->attrs_to_redraw = 0;
+}
+
 int doupdate(void)
 {
-    int y;
+    int y, scr_stride, last_stride;
     bool clearall;
+    unsigned long *blooms;
+    int *spans;
+    uint32_t *scr_rgb, *last_rgb;
 
     PDC_LOG(("doupdate() - called\n"));
 
@@ -167,6 +426,15 @@ int doupdate(void)
     else
         clearall = curscr->_clear;
 
+    blooms = _line_pair_blooms();
+    spans = _blink_spans();
+    if (!clearall && (SP->opaque->pair_blooms_to_redraw ||
+                      SP->opaque->attrs_to_redraw))
+        _spoil_cells_to_redraw(blooms);
+    _clear_cells_to_redraw();
+    scr_rgb = PDC_rgb_plane(curscr, &scr_stride, FALSE);
+    last_rgb = PDC_rgb_plane(SP->lastscr, &last_stride, scr_rgb != NULL);
+
     for (y = 0; y < SP->lines; y++)
     {
         PDC_LOG(("doupdate() - Transforming line %d of %d: %s\n",
@@ -175,21 +443,26 @@ int doupdate(void)
 
         if (clearall || curscr->_firstch[y] != _NO_CHANGE)
         {
-            int first, last;
+            int first, last, first0;
 
             chtype *src = curscr->_y[y];
             chtype *dest = SP->lastscr->_y[y];
+            const uint32_t *srgb = (scr_rgb ? scr_rgb + y * scr_stride : NULL);
+            uint32_t *drgb = (last_rgb ? last_rgb + y * last_stride : NULL);
 
             if (clearall)
             {
                 first = 0;
                 last = COLS - 1;
+                if (blooms)
+                    blooms[y] = 0;
             }
             else
             {
                 first = curscr->_firstch[y];
                 last = curscr->_lastch[y];
             }
+            first0 = first;
 
             while (first <= last)
             {
@@ -203,9 +476,11 @@ int doupdate(void)
                     len = last - first + 1;
                 else
                     while (first + len <= last &&
-                           (src[first + len] != dest[first + len] ||
+                           (!PDC_SAME_CELL(src, dest, srgb, drgb,
+                                           first + len) ||
                             (len && first + len < last &&
-                             src[first + len + 1] != dest[first + len + 1])
+                             !PDC_SAME_CELL(src, dest, srgb, drgb,
+                                            first + len + 1))
                            )
                           )
                         len++;
@@ -216,15 +491,29 @@ int doupdate(void)
                 {
                     PDC_transform_line(y, first, len, src + first);
                     memcpy(dest + first, src + first, len * sizeof(chtype));
+                    PDC_copy_rgb(drgb, srgb, first, first + len - 1);
+                    if (blooms)
+                    {
+                        unsigned long bloom = blooms[y];
+                        int x;
+
+                        for (x = first; x < first + len; x++)
+                            bloom |= _PAIR_BLOOM_BIT(src[x]);
+                        blooms[y] = bloom;
+                    }
                     first += len;
                 }
 
                 /* skip over runs of unchanged cells */
 
-                while (first <= last && src[first] == dest[first])
+                while (first <= last &&
+                       PDC_SAME_CELL(src, dest, srgb, drgb, first))
                     first++;
             }
 
+            if (spans)
+                _update_blink_span(spans, y, first0, last);
+
             PDC_set_changed_cells_range( curscr, y, _NO_CHANGE, _NO_CHANGE);
         }
     }
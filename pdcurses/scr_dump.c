@@ -213,6 +213,7 @@ WINDOW *getwin(FILE *filep)
         win->_y = saved_y;
         win->_firstch = saved_firstch;
         win->_lastch  = saved_lastch;
+        win->_flags &= ~_SPARSE;     /* read back as an ordinary pad */
     }
     win->_attrs = _get_chtype_from_eight_bytes( buff);
     win->_bkgd = _get_chtype_from_eight_bytes( buff + 8);
@@ -40,47 +40,117 @@ scroll
 
 **man-end****************************************************************/
 
+/* A window that neither is a subwindow nor has any subwindows has its
+   lines to itself, and can scroll by rotating its line pointers instead
+   of moving the lines' contents */
+
+static bool _owns_lines(const WINDOW *win)
+{
+    int i;
+
+    if (win->_flags & (_SUBWIN|_SUBPAD))
+        return FALSE;
+
+    for (i = 0; i < SP->opaque->n_windows; i++)
+        if (SP->opaque->window_list[i]->_parent == win)
+            return FALSE;
+
+    return TRUE;
+}
+
+static void _reverse_lines(chtype **first, chtype **last)
+{
+    while (first < last)
+    {
+        chtype *tptr = *first;
+
+        *first++ = *last;
+        *last-- = tptr;
+    }
+}
+
+/* rotate lines[0..n_lines - 1] so that line n becomes line 0 */
+
+static void _rotate_lines(chtype **lines, int n_lines, int n)
+{
+    _reverse_lines(lines, lines + n - 1);
+    _reverse_lines(lines + n, lines + n_lines - 1);
+    _reverse_lines(lines, lines + n_lines - 1);
+}
+
 int wscrl(WINDOW *win, int n)
 {
-    int start, end, n_lines;
+    int start, end, n_lines, y;
     chtype blank, *tptr, *endptr;
+    bool rotate;
 
     /* Check if window scrolls. Valid for window AND pad */
 
     assert( win);
-    if (!win || !win->_scroll || !n)
+    if (!win || !win->_scroll || !n || (win->_flags & _FILEPAD))
         return ERR;
 
     blank = win->_bkgd;
     start = win->_tmarg;
     end = win->_bmarg + 1;
     n_lines = end - start;
+    rotate = _owns_lines(win);
 
     if (n > 0)             /* scroll up */
     {
         if( n > n_lines)
             n = n_lines;
-        memmove( win->_y[start], win->_y[start + n],
-                     (n_lines - n) * win->_maxx * sizeof( chtype));
-        tptr = win->_y[end - n];
+        if( rotate)
+        {
+            if( n < n_lines)
+                _rotate_lines( win->_y + start, n_lines, n);
+        }
+        else      /* lines are shared; move their contents */
+            for( y = start; y < end - n; y++)
+            {
+                if( !PDC_writable_line( win, y))
+                    return ERR;
+                memcpy( win->_y[y], win->_y[y + n],
+                        win->_maxx * sizeof( chtype));
+            }
+        PDC_scroll_rgb_plane( win, start, n_lines, n);
+        start = end - n;
     }
     else                  /* scroll down */
     {
         n = -n;
         if( n > n_lines)
             n = n_lines;
-        memmove( win->_y[start + n], win->_y[start],
-                     (n_lines - n) * win->_maxx * sizeof( chtype));
-        tptr = win->_y[win->_tmarg];
+        if( rotate)
+        {
+            if( n < n_lines)
+                _rotate_lines( win->_y + start, n_lines, n_lines - n);
+        }
+        else
+            for( y = end - 1; y >= start + n; y--)
+            {
+                if( !PDC_writable_line( win, y))
+                    return ERR;
+                memcpy( win->_y[y], win->_y[y - n],
+                        win->_maxx * sizeof( chtype));
+            }
+        PDC_scroll_rgb_plane( win, start, n_lines, -n);
     }
 
         /* make blank lines */
 
-    endptr = tptr + n * win->_maxx;
-    while( tptr < endptr)
-        *tptr++ = blank;
-
-    touchline(win, start, n_lines);
+    for( y = start; y < start + n; y++)
+        if( !PDC_release_line( win, y, blank))
+        {
+            tptr = PDC_writable_line( win, y);
+            if( !tptr)
+                return ERR;
+            endptr = tptr + win->_maxx;
+            while( tptr < endptr)
+                *tptr++ = blank;
+        }
+
+    touchline(win, win->_tmarg, n_lines);
 
     PDC_sync(win);
     return OK;
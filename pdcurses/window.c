@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <curspriv.h>
 #include <assert.h>
+#include <string.h>
 
 /*man-start**************************************************************
 
@@ -228,6 +229,22 @@ void PDC_sync(WINDOW *win)
         wsyncup(win);
 }
 
+/* Lines are allocated as one block, but scrolling and line
+   insertion/deletion may have rotated the line pointers since, so the
+   start of the block is whichever line comes first in memory */
+
+static chtype *_line_block(const WINDOW *win)
+{
+    chtype *block = win->_y[0];
+    int i;
+
+    for (i = 1; i < win->_maxy; i++)
+        if (win->_y[i] < block)
+            block = win->_y[i];
+
+    return block;
+}
+
 #define is_power_of_two( X)   (!((X) & ((X) - 1)))
 
 static void _resize_window_list( SCREEN *scr_ptr)
@@ -309,11 +326,17 @@ int delwin(WINDOW *win)
         _resize_window_list( SP);
     }
 
+    if (win->_flags & _FILEPAD)
+        PDC_free_file_pad(win);
+    PDC_free_rgb_plane(win);
+
     /* subwindows use parents' lines */
 
-    if (!(win->_flags & (_SUBWIN|_SUBPAD)))
+    if (win->_flags & _SPARSE)
+        PDC_free_sparse_lines(win);
+    else if (!(win->_flags & (_SUBWIN|_SUBPAD)))
         if (win->_y[0])
-           free(win->_y[0]);
+           free(_line_block(win));
 
     if( win->_firstch)
         free(win->_firstch);
@@ -366,6 +389,14 @@ WINDOW *subwin(WINDOW *orig, int nlines, int ncols, int begy, int begx)
     assert( nlines > 0 && ncols > 0);
     if( nlines <= 0 || ncols <= 0)
         return (WINDOW *)NULL;
+
+    /* lines of a sparse pad must have storage of their own before a
+       subwindow can point into them */
+
+    for (i = 0; i < nlines; i++)
+        if (!PDC_writable_line(orig, j + i))
+            return (WINDOW *)NULL;
+
     win = PDC_makenew(nlines, ncols, begy, begx);
     if (!win)
         return (WINDOW *)NULL;
@@ -414,6 +445,10 @@ int mvderwin(WINDOW *win, int pary, int parx)
                                 (parx + win->_maxx) > mypar->_maxx)
         return ERR;
 
+    for (i = 0; i < win->_maxy; i++)
+        if (!PDC_writable_line(mypar, pary + i))
+            return ERR;
+
     j = pary;
 
     for (i = 0; i < win->_maxy; i++)
@@ -478,7 +513,7 @@ WINDOW *dupwin(WINDOW *win)
     new_win->_pary = win->_pary;
     new_win->_parent = win->_parent;
     new_win->_bkgd = win->_bkgd;
-    new_win->_flags = win->_flags;
+    new_win->_flags = win->_flags & ~(_SPARSE|_FILEPAD);  /* plain copy */
     PDC_add_window_to_list( new_win);
 
     return new_win;
@@ -541,7 +576,38 @@ WINDOW *resize_window(WINDOW *win, int nlines, int ncols)
     save_curx = min(win->_curx, (new_win->_maxx - 1));
     save_cury = min(win->_cury, (new_win->_maxy - 1));
 
-    if (!(win->_flags & (_SUBPAD|_SUBWIN)))
+    if (win->_flags & _SPARSE)
+    {
+        int i;
+
+        new_win->_bkgd = win->_bkgd;
+        new_win = PDC_makesparselines(new_win);
+        if (!new_win)
+            return (WINDOW *)NULL;
+
+        /* copy only the lines that aren't blank */
+
+        for (i = 0; i < min(win->_maxy, new_win->_maxy); i++)
+            if (win->_y[i] != _SPARSE_BLANK_LINE(win))
+            {
+                chtype *line = PDC_writable_line(new_win, i);
+
+                if (!line)
+                {
+                    PDC_free_sparse_lines(new_win);
+                    free(new_win->_firstch);
+                    free(new_win->_y);
+                    free(new_win);
+                    return (WINDOW *)NULL;
+                }
+
+                memcpy(line, win->_y[i],
+                       min(win->_maxx, new_win->_maxx) * sizeof(chtype));
+            }
+
+        PDC_free_sparse_lines(win);
+    }
+    else if (!(win->_flags & (_SUBPAD|_SUBWIN)))
     {
         new_win = PDC_makelines(new_win);
         if (!new_win)
@@ -554,7 +620,7 @@ WINDOW *resize_window(WINDOW *win, int nlines, int ncols)
                 min(win->_maxx, new_win->_maxx) - 1, FALSE);
 
         if (win->_y[0])
-            free(win->_y[0]);
+            free(_line_block(win));
     }
 
     new_win->_flags = win->_flags;
@@ -2,6 +2,7 @@
 
 #include "pdcsdl.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -14,62 +15,225 @@
 # include "../common/acs_defs.h"
 # include "../common/pdccolor.h"
 
-#define MAXRECT 200     /* maximum number of rects to queue up before
-                           an update is forced; the number was chosen
-                           arbitrarily */
-
-static SDL_Rect uprect[MAXRECT];       /* table of rects to update */
 static chtype oldch = (chtype)(-1);    /* current attribute */
-static int rectcount = 0;              /* index into uprect */
 static int foregr = -2, backgr = -2; /* current foreground, background */
 static bool blinked_off = FALSE;
+
+/* Changed areas are tracked as one span of pixels per row of cells:
+   _dirty_x1[row] up to (not including) _dirty_x2[row], for rows from
+   _dirty_row1 up to _dirty_row2.  PDC_update_rects() turns those into
+   rectangles, running each one down through following rows whose spans
+   line up to within a cell, and hands them to SDL in a single call.  So
+   however scattered the changes, there are never more rectangles than
+   rows, and only what changed is presented. */
+
+static int *_dirty_x1 = NULL, *_dirty_x2 = NULL;
+static SDL_Rect *_dirty_rects = NULL;
+static int _dirty_rows_alloced = 0;
+static int _dirty_row1 = 0, _dirty_row2 = 0;
+static bool _dirty_all = FALSE;       /* out of memory; update it all */
+
+void PDC_free_dirty_spans(void)
+{
+    free(_dirty_x1);
+    free(_dirty_rects);
+    _dirty_x1 = _dirty_x2 = NULL;
+    _dirty_rects = NULL;
+    _dirty_rows_alloced = _dirty_row1 = _dirty_row2 = 0;
+    _dirty_all = FALSE;
+}
+
+static bool _grow_dirty_spans(const int n_rows)
+{
+    SDL_Rect *new_rects = (SDL_Rect *)realloc(_dirty_rects,
+                                              n_rows * sizeof(SDL_Rect));
+    int *new_x1;
+    int i;
+
+    if (!new_rects)
+        return FALSE;
+    _dirty_rects = new_rects;
+
+    new_x1 = (int *)realloc(_dirty_x1, 2 * n_rows * sizeof(int));
+    if (!new_x1)
+        return FALSE;
+
+    /* the x2 half moves up to make room for the new x1 rows */
+
+    memmove(new_x1 + n_rows, new_x1 + _dirty_rows_alloced,
+            _dirty_rows_alloced * sizeof(int));
+    _dirty_x1 = new_x1;
+    _dirty_x2 = new_x1 + n_rows;
+    for (i = _dirty_rows_alloced; i < n_rows; i++)
+    {
+        _dirty_x1[i] = INT_MAX;
+        _dirty_x2[i] = 0;
+    }
+    _dirty_rows_alloced = n_rows;
+    return TRUE;
+}
+
+static void _add_dirty_rect(const SDL_Rect *r)
+{
+    int row, row1, row2;
+
+    if (r->w <= 0 || r->h <= 0 || _dirty_all)
+        return;
+
+    row1 = max(r->y - pdc_yoffset, 0) / pdc_fheight;
+    row2 = max(r->y + r->h - 1 - pdc_yoffset, 0) / pdc_fheight + 1;
+
+    if (row2 > _dirty_rows_alloced && !_grow_dirty_spans(row2 + 16))
+    {
+        _dirty_all = TRUE;
+        return;
+    }
+
+    for (row = row1; row < row2; row++)
+    {
+        if (_dirty_x1[row] > r->x)
+            _dirty_x1[row] = r->x;
+        if (_dirty_x2[row] < r->x + r->w)
+            _dirty_x2[row] = r->x + r->w;
+    }
+
+    if (_dirty_row1 > row1 || _dirty_row1 >= _dirty_row2)
+        _dirty_row1 = row1;
+    if (_dirty_row2 < row2)
+        _dirty_row2 = row2;
+}
+
+static void _clear_dirty_spans(void)
+{
+    int row;
+
+    for (row = _dirty_row1; row < _dirty_row2; row++)
+    {
+        _dirty_x1[row] = INT_MAX;
+        _dirty_x2[row] = 0;
+    }
+    _dirty_row1 = _dirty_row2 = 0;
+    _dirty_all = FALSE;
+}
+
+/* copy part of pdc_screen to the streaming texture */
+
+static void _copy_to_texture(const SDL_Rect *rect)
+{
+    const Uint8 *src = (const Uint8 *)pdc_screen->pixels
+                     + rect->y * pdc_screen->pitch + rect->x * 4;
+    void *pixels;
+    int pitch, y;
+
+    if (SDL_LockTexture(pdc_texture, rect, &pixels, &pitch))
+        return;
+
+    for (y = 0; y < rect->h; y++)
+        memcpy((Uint8 *)pixels + y * pitch, src + y * pdc_screen->pitch,
+               rect->w * 4);
+
+    SDL_UnlockTexture(pdc_texture);
+}
+
+/* show the given parts of pdc_screen;  with n_rects == 0, all of it */
+
+static void _present(const SDL_Rect *rects, int n_rects)
+{
+    if (pdc_headless)
+        return;
+
+    if (pdc_texture)
+    {
+        SDL_Rect all;
+        int i;
+
+        if (!n_rects)
+        {
+            all.x = all.y = 0;
+            all.w = pdc_screen->w;
+            all.h = pdc_screen->h;
+            rects = &all;
+            n_rects = 1;
+        }
+
+        for (i = 0; i < n_rects; i++)
+            _copy_to_texture(rects + i);
+
+        SDL_RenderCopy(pdc_renderer, pdc_texture, NULL, NULL);
+        SDL_RenderPresent(pdc_renderer);
+    }
+    else if (!n_rects)
+        SDL_UpdateWindowSurface(pdc_window);
+    else
+        SDL_UpdateWindowSurfaceRects(pdc_window, rects, n_rects);
+}
+
 /* do the real updates on a delay */
 
 void PDC_update_rects(void)
 {
-    int i;
+    const int w = pdc_screen->w;
+    const int h = pdc_screen->h;
+    int row, i, n_rects = 0, n_visible = 0;
+
+    if (_dirty_all)
+    {
+        _present(NULL, 0);
+        _clear_dirty_spans();
+        return;
+    }
 
-    if (rectcount)
+    for (row = _dirty_row1; row < _dirty_row2; row++)
     {
-        /* if the maximum number of rects has been reached, we're
-           probably better off doing a full screen update */
+        const int x1 = _dirty_x1[row], x2 = _dirty_x2[row];
+        const int y = row * pdc_fheight + pdc_yoffset;
 
-        if (rectcount == MAXRECT)
-            SDL_UpdateWindowSurface(pdc_window);
-        else
+        if (x1 >= x2)
+            continue;
+
+        if (n_rects)
         {
-            int w = pdc_screen->w;
-            int h = pdc_screen->h;
+            SDL_Rect *rect = _dirty_rects + n_rects - 1;
 
-            for (i = 0; i < rectcount; i++)
+            if (rect->y + rect->h == y
+                    && abs(rect->x - x1) < pdc_fwidth
+                    && abs(rect->x + rect->w - x2) < pdc_fwidth)
             {
-                if (uprect[i].x > w ||
-                    uprect[i].y > h ||
-                    !uprect[i].w || !uprect[i].h)
-                {
-                    if (i + 1 < rectcount)
-                    {
-                        memmove(uprect + i, uprect + i + 1,
-                                (rectcount - i + 1) * sizeof(*uprect));
-                        --i;
-                    }
-                    rectcount--;
-                    continue;
-                }
-
-                if (uprect[i].x + uprect[i].w > w)
-                    uprect[i].w = min(w, w - uprect[i].x);
-
-                if (uprect[i].y + uprect[i].h > h)
-                    uprect[i].h = min(h, h - uprect[i].y);
-            }
+                const int rx2 = max(rect->x + rect->w, x2);
 
-            if (rectcount > 0)
-                SDL_UpdateWindowSurfaceRects(pdc_window, uprect, rectcount);
+                rect->x = min(rect->x, x1);
+                rect->w = rx2 - rect->x;
+                rect->h += pdc_fheight;
+                continue;
+            }
         }
 
-        rectcount = 0;
+        _dirty_rects[n_rects].x = x1;
+        _dirty_rects[n_rects].y = y;
+        _dirty_rects[n_rects].w = x2 - x1;
+        _dirty_rects[n_rects].h = pdc_fheight;
+        n_rects++;
+    }
+
+    _clear_dirty_spans();
+
+    /* clip to the window, dropping anything entirely outside it */
+
+    for (i = 0; i < n_rects; i++)
+    {
+        SDL_Rect rect = _dirty_rects[i];
+
+        if (rect.x >= w || rect.y >= h)
+            continue;
+        if (rect.x + rect.w > w)
+            rect.w = w - rect.x;
+        if (rect.y + rect.h > h)
+            rect.h = h - rect.y;
+        _dirty_rects[n_visible++] = rect;
     }
+
+    if (n_visible)
+        _present(_dirty_rects, n_visible);
 }
 
 static SDL_Color *get_pdc_color( const int color_idx)
@@ -90,9 +254,20 @@ static Uint32 get_pdc_mapped( const int color_idx)
    return( SDL_MapRGB( pdc_screen->format, c->r, c->g, c->b));
 }
 
-/* set the font colors to match the chtype's attribute */
+/* RGB plane values (see wadd_rgb_ch()) for a cell of curscr,  or NULL */
+
+static const uint32_t *_cell_rgb(const int row, const int col)
+{
+    int stride;
+    const uint32_t *rgb = PDC_rgb_plane(curscr, &stride, FALSE);
+
+    return (rgb ? rgb + row * stride + col * 2 : NULL);
+}
+
+/* set the font colors to match the chtype's attribute;  a cell with
+   its own RGB colors gets them as palette indices 256 and up */
 
-static void _set_attr(chtype ch)
+static void _set_attr(chtype ch, const uint32_t *cell_rgb)
 {
     attr_t sysattrs = SP->termattrs;
 
@@ -104,9 +279,9 @@ static void _set_attr(chtype ch)
             TTF_STYLE_ITALIC : 0) );
 #endif
 
-    ch &= (A_COLOR|A_BOLD|A_BLINK|A_REVERSE);
+    ch &= (A_COLOR|A_BOLD|A_BLINK|A_REVERSE|PDC_RGB_CELL);
 
-    if (oldch != ch)
+    if (oldch != ch || (ch & PDC_RGB_CELL))
     {
         int newfg, newbg;
 
@@ -120,6 +295,14 @@ static void _set_attr(chtype ch)
         if ((ch & A_BLINK) && !(sysattrs & A_BLINK))
             newbg |= 8;
 
+        if ((ch & PDC_RGB_CELL) && cell_rgb)
+        {
+            if (cell_rgb[0] != PDC_RGB_NONE)
+                newfg = 256 + (int)cell_rgb[0];
+            if (cell_rgb[1] != PDC_RGB_NONE)
+                newbg = 256 + (int)cell_rgb[1];
+        }
+
         if (ch & A_REVERSE)
         {
             int tmp = newfg;
@@ -243,23 +426,25 @@ static bool _grprint(chtype ch, const SDL_Rect dest)
     return( rval);
 }
 
+/* render a glyph in white (on black, for the 'shaded' mode);  the
+   result only matters as coverage,  see _cache_glyph() */
+
 static SDL_Surface *_render_ttf_glyph(chtype ch)
 {
+    const SDL_Color white = {255, 255, 255, 255}, black = {0, 0, 0, 255};
+
     ch &= A_CHARTEXT;
 
 #ifdef PDC_SDL_SUPPLEMENTARY_PLANES_SUPPORT
     switch (pdc_sdl_render_mode)
     {
     case PDC_SDL_RENDER_SOLID:
-        return TTF_RenderGlyph32_Solid(pdc_ttffont, (Uint32)ch,
-                                       *(get_pdc_color( foregr)));
+        return TTF_RenderGlyph32_Solid(pdc_ttffont, (Uint32)ch, white);
     case PDC_SDL_RENDER_SHADED:
         return TTF_RenderGlyph32_Shaded(pdc_ttffont, (Uint32)ch,
-                                        *(get_pdc_color( foregr)),
-                                        *(get_pdc_color( backgr)));
+                                        white, black);
     default:
-        return TTF_RenderGlyph32_Blended(pdc_ttffont, (Uint32)ch,
-                                         *(get_pdc_color( foregr)));
+        return TTF_RenderGlyph32_Blended(pdc_ttffont, (Uint32)ch, white);
     }
 #else
     /* no support for supplementary planes */
@@ -269,20 +454,181 @@ static SDL_Surface *_render_ttf_glyph(chtype ch)
     switch (pdc_sdl_render_mode)
     {
     case PDC_SDL_RENDER_SOLID:
-        return TTF_RenderGlyph_Solid(pdc_ttffont, (Uint16)ch,
-                                     *(get_pdc_color( foregr)));
-        break;
+        return TTF_RenderGlyph_Solid(pdc_ttffont, (Uint16)ch, white);
     case PDC_SDL_RENDER_SHADED:
         return TTF_RenderGlyph_Shaded(pdc_ttffont, (Uint16)ch,
-                                      *(get_pdc_color( foregr)),
-                                      *(get_pdc_color( backgr)));
+                                      white, black);
     default:
-        return TTF_RenderGlyph_Blended(pdc_ttffont, (Uint16)ch,
-                                       *(get_pdc_color( foregr)));
+        return TTF_RenderGlyph_Blended(pdc_ttffont, (Uint16)ch, white);
     }
 #endif
 }
 
+/* Rendering a TrueType glyph is far slower than blitting one, so each
+   glyph is rendered once (per style and render mode) into a cell-sized
+   slot of an atlas surface.  The atlas holds only coverage, as alpha
+   over white;  it's colorized at blit time by modulating with the
+   foreground color and alpha-blending onto the (already filled)
+   background.  When all slots are used, the whole cache is flushed and
+   refilled as glyphs are drawn again.  */
+
+#define ATLAS_COLS 32
+#define ATLAS_ROWS 32
+#define ATLAS_SLOTS (ATLAS_COLS * ATLAS_ROWS)
+#define ATLAS_HASH_SIZE (ATLAS_SLOTS * 2)    /* a power of two */
+#define ATLAS_NO_GLYPH 0xffff
+
+static SDL_Surface *_atlas = NULL;
+static int _atlas_fwidth, _atlas_fheight;
+static int _atlas_slots_used, _atlas_entries;
+static struct
+{
+    Uint32 key;          /* character | style | render mode; 0 = empty */
+    Uint16 slot;         /* or ATLAS_NO_GLYPH if it didn't render */
+} _atlas_hash[ATLAS_HASH_SIZE];
+
+void PDC_free_glyph_atlas(void)
+{
+    if (_atlas)
+        SDL_FreeSurface(_atlas);
+    _atlas = NULL;
+}
+
+static void _flush_glyph_atlas(void)
+{
+    memset(_atlas_hash, 0, sizeof(_atlas_hash));
+    _atlas_slots_used = _atlas_entries = 0;
+}
+
+/* copy a rendered glyph's coverage into an atlas slot, centered if it's
+   narrower than a cell and clipped if it's wider (as the glyphs were
+   when blitted directly) */
+
+static void _cache_glyph(SDL_Surface *surf, const int slot)
+{
+    const int center = pdc_fwidth > surf->w ? (pdc_fwidth - surf->w) >> 1 : 0;
+    const int w = min(surf->w, pdc_fwidth - center);
+    const int h = min(surf->h, pdc_fheight);
+    const int bpp = surf->format->BytesPerPixel;
+    const SDL_Palette *palette = surf->format->palette;
+    Uint8 *row = (Uint8 *)_atlas->pixels
+               + (slot / ATLAS_COLS) * pdc_fheight * _atlas->pitch
+               + (slot % ATLAS_COLS) * pdc_fwidth * 4;
+    int x, y;
+
+    for (y = 0; y < pdc_fheight; y++)
+        memset(row + y * _atlas->pitch, 0, pdc_fwidth * 4);
+
+    if (SDL_MUSTLOCK(surf))
+        SDL_LockSurface(surf);
+
+    for (y = 0; y < h; y++)
+    {
+        const Uint8 *src = (const Uint8 *)surf->pixels + y * surf->pitch;
+        Uint32 *dest = (Uint32 *)(row + y * _atlas->pitch) + center;
+
+        for (x = 0; x < w; x++)
+        {
+            Uint8 r, g, b, a;
+
+            /* 'solid' and 'shaded' glyphs are 8-bit, with a palette
+               running from black (background) to white;  'blended'
+               ones are 32-bit, with the coverage in alpha */
+
+            if (bpp == 1)
+                a = palette->colors[src[x]].r;
+            else
+                SDL_GetRGBA(((const Uint32 *)src)[x], surf->format,
+                            &r, &g, &b, &a);
+
+            dest[x] = ((Uint32)a << 24) | 0xffffff;
+        }
+    }
+
+    if (SDL_MUSTLOCK(surf))
+        SDL_UnlockSurface(surf);
+}
+
+/* returns the atlas slot for 'ch' in the current font style and render
+   mode, rendering it if need be;  or -1 if there's nothing to draw */
+
+static int _get_atlas_slot(chtype ch)
+{
+    const Uint32 key = ((Uint32)(ch & 0x1fffff)
+                     | ((Uint32)(TTF_GetFontStyle(pdc_ttffont)
+                                 & (TTF_STYLE_BOLD | TTF_STYLE_ITALIC)) << 21)
+                     | ((Uint32)pdc_sdl_render_mode << 24)) + 1;
+    Uint32 idx = (key * 2654435761u) & (ATLAS_HASH_SIZE - 1);
+    SDL_Surface *surf;
+
+    if (!_atlas || _atlas_fwidth != pdc_fwidth
+                || _atlas_fheight != pdc_fheight)
+    {
+        PDC_free_glyph_atlas();
+        _atlas = SDL_CreateRGBSurface(0, ATLAS_COLS * pdc_fwidth,
+                                      ATLAS_ROWS * pdc_fheight, 32,
+                                      0x00ff0000, 0x0000ff00, 0x000000ff,
+                                      0xff000000);
+        if (!_atlas)
+            return -1;
+        SDL_SetSurfaceBlendMode(_atlas, SDL_BLENDMODE_BLEND);
+        _atlas_fwidth = pdc_fwidth;
+        _atlas_fheight = pdc_fheight;
+        _flush_glyph_atlas();
+    }
+
+    while (_atlas_hash[idx].key && _atlas_hash[idx].key != key)
+        idx = (idx + 1) & (ATLAS_HASH_SIZE - 1);
+
+    if (_atlas_hash[idx].key != key)
+    {
+        /* glyphs that didn't render take a hash entry but no slot, so
+           counting entries keeps the hash table at most half full, too */
+
+        if (_atlas_entries == ATLAS_SLOTS)
+        {
+            _flush_glyph_atlas();
+            idx = (key * 2654435761u) & (ATLAS_HASH_SIZE - 1);
+        }
+
+        surf = _render_ttf_glyph(ch);
+        _atlas_entries++;
+        _atlas_hash[idx].key = key;
+        _atlas_hash[idx].slot = ATLAS_NO_GLYPH;
+
+        if (surf)
+        {
+            _atlas_hash[idx].slot = (Uint16)_atlas_slots_used++;
+            _cache_glyph(surf, _atlas_hash[idx].slot);
+            SDL_FreeSurface(surf);
+        }
+    }
+
+    return (_atlas_hash[idx].slot == ATLAS_NO_GLYPH ?
+            -1 : (int)_atlas_hash[idx].slot);
+}
+
+/* draw 'ch' in the current foreground color over 'dest';  'yoff' skips
+   that many rows at the top of the glyph, for the partial-cell cursor */
+
+static void _blit_glyph(chtype ch, const int yoff, const SDL_Rect *dest)
+{
+    const int slot = _get_atlas_slot(ch);
+
+    if (slot >= 0)
+    {
+        const SDL_Color *c = get_pdc_color(foregr);
+        SDL_Rect src, tdest = *dest;
+
+        src.x = (slot % ATLAS_COLS) * pdc_fwidth;
+        src.y = (slot / ATLAS_COLS) * pdc_fheight + yoff;
+        src.w = pdc_fwidth;
+        src.h = dest->h;
+        SDL_SetSurfaceColorMod(_atlas, c->r, c->g, c->b);
+        SDL_BlitSurface(_atlas, &src, pdc_screen, &tdest);
+    }
+}
+
 #endif
 
 /* draw a cursor at (y, x) */
@@ -315,7 +661,7 @@ void PDC_gotoyx(int row, int col)
 
     ch = curscr->_y[row][col] ^ A_REVERSE;
 
-    _set_attr(ch);
+    _set_attr(ch, _cell_rgb(row, col));
 
     src.h = (SP->visibility == 1) ? pdc_fheight >> 2 : pdc_fheight;
     src.w = pdc_fwidth;
@@ -334,20 +680,7 @@ void PDC_gotoyx(int row, int col)
         if( _is_altcharset( ch))
             ch = acs_map[ch & 0x7f];
 
-        pdc_font = _render_ttf_glyph(ch);
-
-        if (pdc_font)
-        {
-            int center = pdc_fwidth > pdc_font->w ?
-                        (pdc_fwidth - pdc_font->w) >> 1 : 0;
-            src.x = 0;
-            src.y = pdc_fheight - src.h;
-            dest.x += center;
-            SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
-            dest.x -= center;
-            SDL_FreeSurface(pdc_font);
-            pdc_font = NULL;
-        }
+        _blit_glyph(ch, pdc_fheight - src.h, &dest);
     }
 #else
     if( _is_altcharset( ch))
@@ -360,86 +693,34 @@ void PDC_gotoyx(int row, int col)
 #endif
 
     if (oldrow != row || oldcol != col)
-    {
-        if (rectcount == MAXRECT)
-            PDC_update_rects();
+        _add_dirty_rect(&dest);
 
-        uprect[rectcount++] = dest;
-    }
     PDC_update_rects();
 }
 
-static bool _merge_rects( SDL_Rect *a, const SDL_Rect *b)
-{
-    if( a->x == b->x && a->w == b->w)
-    {
-        const int ay = a->y + a->h;
-        const int by = b->y + b->h;
-
-        if( ay >= b->y && by >= a->y)
-        {
-            const int y1 = min( a->y, b->y);
-            const int y2 = max( ay, by);
-
-            a->y = y1;
-            a->h = y2 - y1;
-            return TRUE;
-        }
-    }
-    if( a->y == b->y && a->h == b->h)
-    {
-        const int ax = a->x + a->w;
-        const int bx = b->x + b->w;
-
-        if( ax >= b->x && bx >= a->x)
-        {
-            const int x1 = min( a->x, b->x);
-            const int x2 = max( ax, bx);
-
-            a->x = x1;
-            a->w = x2 - x1;
-            return TRUE;
-        }
-    }
-    return FALSE;
-}
-
 void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
 {
-    SDL_Rect src, dest;
-    int j;
-#ifdef PDC_WIDE
-    chtype prev_ch = 0;
+    SDL_Rect dest;
+#ifndef PDC_WIDE
+    SDL_Rect src;
 #endif
+    int j;
     attr_t sysattrs = SP->termattrs;
-    short hcol = SP->line_color;
+    int hcol = SP->line_color;
     bool blink = blinked_off && (attr & A_BLINK) && (sysattrs & A_BLINK);
 
-    if (rectcount == MAXRECT)
-        PDC_update_rects();
-
-#ifdef PDC_WIDE
-    src.x = 0;
-    src.y = 0;
-#endif
+#ifndef PDC_WIDE
     src.h = pdc_fheight;
     src.w = pdc_fwidth;
+#endif
 
     dest.y = pdc_fheight * lineno + pdc_yoffset;
     dest.x = pdc_fwidth * x + pdc_xoffset;
     dest.h = pdc_fheight;
     dest.w = pdc_fwidth * len;
-    uprect[rectcount++] = dest;
-
-    /* we try merging the new rectangle with the previous one.  It's
-       possible the result can be merged with the one before that,
-       and so on.  */
-
-    while( rectcount >= 2 && _merge_rects( uprect + rectcount - 2,
-                                           uprect + rectcount - 1))
-       rectcount--;
+    _add_dirty_rect(&dest);
 
-    _set_attr(attr);
+    _set_attr(attr, _cell_rgb(lineno, x));
 
     if (backgr == -1)
         SDL_BlitSurface(pdc_tileback, &dest, pdc_screen, &dest);
@@ -449,7 +730,7 @@ void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
 #endif
 
     if (hcol == -1)
-        hcol = (short)foregr;
+        hcol = foregr;
 
     for (j = 0; j < len; j++)
     {
@@ -476,25 +757,7 @@ void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
         ch &= A_CHARTEXT;
 
         if (ch != ' ')
-        {
-            if (prev_ch != ch)
-            {
-                prev_ch = ch;
-                if (pdc_font)
-                    SDL_FreeSurface(pdc_font);
-
-                pdc_font = _render_ttf_glyph(ch);
-            }
-
-            if (pdc_font)
-            {
-                int center = pdc_fwidth > pdc_font->w ?
-                    (pdc_fwidth - pdc_font->w) >> 1 : 0;
-                dest.x += center;
-                SDL_BlitSurface(pdc_font, &src, pdc_screen, &dest);
-                dest.x -= center;
-            }
-        }
+            _blit_glyph(ch, 0, &dest);
 #else
         src.x = (ch & 0xff) % 32 * pdc_fwidth;
         src.y = (ch & 0xff) / 32 * pdc_fheight;
@@ -520,14 +783,6 @@ void _new_packet(attr_t attr, int lineno, int x, int len, const chtype *srcp)
         dest.x += pdc_fwidth;
     }
 
-#ifdef PDC_WIDE
-    if (pdc_font)
-    {
-        SDL_FreeSurface(pdc_font);
-        pdc_font = NULL;
-    }
-#endif
-
     if (!blink && (attr & (A_UNDERLINE | A_OVERLINE | A_STRIKEOUT)))
     {
         dest.x = pdc_fwidth * x + pdc_xoffset;
@@ -559,13 +814,15 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 
     PDC_LOG(("PDC_transform_line() - called: lineno=%d\n", lineno));
 
-    old_attr = *srcp & (A_ATTRIBUTES ^ A_ALTCHARSET);
+    old_attr = *srcp & ((A_ATTRIBUTES ^ A_ALTCHARSET) | PDC_RGB_CELL);
 
     for (i = 1, j = 1; j < len; i++, j++)
     {
-        attr = srcp[i] & (A_ATTRIBUTES ^ A_ALTCHARSET);
+        attr = srcp[i] & ((A_ATTRIBUTES ^ A_ALTCHARSET) | PDC_RGB_CELL);
+
+        /* cells with their own RGB colors get a packet each */
 
-        if (attr != old_attr)
+        if (attr != old_attr || ((attr | old_attr) & PDC_RGB_CELL))
         {
             _new_packet(old_attr, lineno, x, i, srcp);
             old_attr = attr;
@@ -588,49 +845,64 @@ static Uint32 _blink_timer(Uint32 interval, void *param)
     return(interval);
 }
 
-void PDC_blink_text(void)
-{
-    static SDL_TimerID blinker_id = 0;
-    int i, j, k;
+static SDL_TimerID blinker_id = 0;
 
-    oldch = (chtype)(-1);
+/* The blink timer runs only while A_BLINK is enabled and some line of
+   the screen holds blinking text (or the text is blinked off, and has to
+   be brought back); PDC_doupdate() starts it when blinking text shows up. */
+
+static void _check_blink_timer(void)
+{
+    const bool needed = ((SP->termattrs & A_BLINK)
+                         && (blinked_off || PDC_n_blinking_lines()));
 
-    if (!(SP->termattrs & A_BLINK))
+    if (!needed && blinker_id)
     {
         SDL_RemoveTimer(blinker_id);
         blinker_id = 0;
     }
-    else if (!blinker_id)
-    {
+    else if (needed && !blinker_id)
         blinker_id = SDL_AddTimer(500, _blink_timer, NULL);
-        blinked_off = TRUE;
-    }
+}
 
-    blinked_off = !blinked_off;
+void PDC_blink_text(void)
+{
+    oldch = (chtype)(-1);
 
-    for (i = 0; i < SP->lines; i++)
-    {
-        const chtype *srcp = curscr->_y[i];
+    /* blinking text starts out 'on' when the timer (re)starts */
 
-        for (j = 0; j < SP->cols; j++)
-            if (srcp[j] & A_BLINK)
-            {
-                k = j;
-                while (k < SP->cols && (srcp[k] & A_BLINK))
-                    k++;
-                PDC_transform_line(i, j, k - j, srcp + j);
-                j = k;
-            }
-    }
+    if (!(SP->termattrs & A_BLINK) || !blinker_id)
+        blinked_off = FALSE;
+    else
+        blinked_off = !blinked_off;
+
+    PDC_redraw_blinking_cells();
 
     oldch = (chtype)(-1);
 
     PDC_doupdate();
 }
 
+static void (*_capture_callback)(SDL_Surface *, void *) = NULL;
+static void *_capture_data = NULL;
+
+/* Sets a function to be called with pdc_screen after every
+   PDC_doupdate(), once the frame is complete;  NULL removes it. */
+
+void PDC_sdl_capture_frame(void (*callback)(SDL_Surface *screen, void *data),
+                           void *data)
+{
+    _capture_callback = callback;
+    _capture_data = data;
+}
+
 void PDC_doupdate(void)
 {
+    _check_blink_timer();
     PDC_update_rects();
+
+    if (_capture_callback)
+        _capture_callback(pdc_screen, _capture_data);
 }
 
 void PDC_pump_and_peep(void)
@@ -644,8 +916,8 @@ void PDC_pump_and_peep(void)
              SDL_WINDOWEVENT_EXPOSED == event.window.event ||
              SDL_WINDOWEVENT_SHOWN == event.window.event))
         {
-            SDL_UpdateWindowSurface(pdc_window);
-            rectcount = 0;
+            _present(NULL, 0);
+            _clear_dirty_spans();
         }
         else
             SDL_PushEvent(&event);
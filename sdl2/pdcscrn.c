@@ -3,6 +3,7 @@
 #include "pdcsdl.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #ifndef PDC_WIDE
 # include "../common/font437.h"
@@ -32,6 +33,9 @@ int pdc_font_size =
 int pdc_sdl_render_mode = PDC_SDL_RENDER_BLENDED;
 #endif
 
+int pdc_sdl_present_mode = PDC_SDL_PRESENT_SURFACE;
+SDL_Renderer *pdc_renderer = NULL;
+SDL_Texture *pdc_texture = NULL;
 SDL_Window *pdc_window = NULL;
 SDL_Surface *pdc_screen = NULL, *pdc_font = NULL, *pdc_icon = NULL,
             *pdc_back = NULL, *pdc_tileback = NULL;
@@ -39,6 +43,7 @@ int pdc_sheight = 0, pdc_swidth = 0, pdc_yoffset = 0, pdc_xoffset = 0;
 
 int pdc_fheight, pdc_fwidth, pdc_fthick, pdc_flastc;
 bool pdc_own_window;
+bool pdc_headless = FALSE;
 
 #ifndef PDC_WIDE
 
@@ -104,7 +109,9 @@ static SDL_Surface *_load_bmp_and_palette_size(SDL_RWops *bmp_rw, int *palette_s
 
 static void _clean(void)
 {
+    PDC_free_dirty_spans();
 #ifdef PDC_WIDE
+    PDC_free_glyph_atlas();
     if (pdc_ttffont)
     {
         TTF_CloseFont(pdc_ttffont);
@@ -123,6 +130,13 @@ static void _clean(void)
     if( pdc_screen)
         SDL_FreeSurface(pdc_screen);
     pdc_screen = pdc_tileback = pdc_back = pdc_icon = pdc_font = NULL;
+    if( pdc_texture)
+        SDL_DestroyTexture(pdc_texture);
+    if( pdc_renderer)
+        SDL_DestroyRenderer(pdc_renderer);
+    pdc_texture = NULL;
+    pdc_renderer = NULL;
+    pdc_headless = FALSE;
     if( pdc_own_window && pdc_window)
     {
         SDL_DestroyWindow(pdc_window);
@@ -133,6 +147,60 @@ static void _clean(void)
     pdc_sheight = pdc_swidth = 0;
 }
 
+/* The surface PDCurses draws on.  Normally, that's the window's own
+   surface.  With PDC_SDL_PRESENT_TEXTURE, it's an off-screen surface
+   the size of the window;  PDC_update_rects() copies the changed parts
+   to a streaming texture of the same size, which the renderer then
+   scales to fit the window's output (so HiDPI displays get full-sized
+   cells).  When headless, it's an off-screen surface with no texture,
+   so that there's always one to draw on, whatever the video driver
+   provides.  If the texture or its surface can't be created, the
+   renderer is dropped, and the window's surface is used after all.
+   Called on opening, and again when the window is resized. */
+
+SDL_Surface *PDC_get_screen_surface(void)
+{
+    SDL_Surface *surface;
+    int w, h;
+
+    if (!pdc_renderer && !pdc_headless)
+        return SDL_GetWindowSurface(pdc_window);
+
+    SDL_GetWindowSize(pdc_window, &w, &h);
+
+    if (pdc_screen && pdc_screen->w == w && pdc_screen->h == h)
+        return pdc_screen;
+
+    if (pdc_texture)
+        SDL_DestroyTexture(pdc_texture);
+    if (pdc_screen)
+        SDL_FreeSurface(pdc_screen);
+    pdc_texture = NULL;
+    pdc_screen = NULL;
+
+    if (pdc_renderer)
+        pdc_texture = SDL_CreateTexture(pdc_renderer, SDL_PIXELFORMAT_RGB888,
+                                        SDL_TEXTUREACCESS_STREAMING, w, h);
+
+    if (!pdc_renderer || pdc_texture)
+    {
+        surface = SDL_CreateRGBSurface(0, w, h, 32, 0x00ff0000, 0x0000ff00,
+                                       0x000000ff, 0);
+        if (surface || !pdc_renderer)
+            return surface;
+    }
+
+    fprintf(stderr, "Could not set up texture presentation: %s\n",
+            SDL_GetError());
+    if (pdc_texture)
+        SDL_DestroyTexture(pdc_texture);
+    SDL_DestroyRenderer(pdc_renderer);
+    pdc_texture = NULL;
+    pdc_renderer = NULL;
+
+    return SDL_GetWindowSurface(pdc_window);
+}
+
 void PDC_retile(void)
 {
     if (pdc_tileback)
@@ -226,7 +294,21 @@ int PDC_scr_open(void)
 
         atexit(_clean);
 
-        displaynum = _get_displaynum();
+        /* Headless (e.g., for automated tests):  there's no window
+           manager or display to ask about, and only files named in the
+           environment are loaded, so that the output depends only on
+           the settings given. */
+
+        if (!pdc_screen)
+        {
+            const char *driver = SDL_GetCurrentVideoDriver();
+
+            pdc_headless = (driver && (!strcmp(driver, "dummy")
+                                       || !strcmp(driver, "offscreen")));
+        }
+
+        if (!pdc_headless)
+            displaynum = _get_displaynum();
     }
 
 #ifdef PDC_WIDE
@@ -286,7 +368,10 @@ int PDC_scr_open(void)
         int palette_size;
 
         const char *fname = getenv("PDC_FONT");
-        SDL_RWops *file = SDL_RWFromFile(fname ? fname : "pdcfont.bmp", "r");
+        SDL_RWops *file = NULL;
+
+        if (fname || !pdc_headless)
+            file = SDL_RWFromFile(fname ? fname : "pdcfont.bmp", "r");
         if (file)
             pdc_font = _load_bmp_and_palette_size(file, &palette_size);
 
@@ -310,7 +395,9 @@ int PDC_scr_open(void)
     if (!SP->mono && !pdc_back)
     {
         const char *bname = getenv("PDC_BACKGROUND");
-        pdc_back = SDL_LoadBMP(bname ? bname : "pdcback.bmp");
+
+        if (bname || !pdc_headless)
+            pdc_back = SDL_LoadBMP(bname ? bname : "pdcback.bmp");
     }
 
     if (!SP->mono && (pdc_back || !pdc_own_window))
@@ -331,7 +418,7 @@ int PDC_scr_open(void)
     pdc_fthick = 1;
 #endif
 
-    if (pdc_own_window && !pdc_icon)
+    if (pdc_own_window && !pdc_headless && !pdc_icon)
     {
         const char *iname = getenv("PDC_ICON");
         pdc_icon = SDL_LoadBMP(iname ? iname : "pdcicon.bmp");
@@ -357,10 +444,17 @@ int PDC_scr_open(void)
         }
         pdc_swidth *= pdc_fwidth;
 
-        pdc_window = SDL_CreateWindow("PDCurses",
-            SDL_WINDOWPOS_CENTERED_DISPLAY(displaynum),
-            SDL_WINDOWPOS_CENTERED_DISPLAY(displaynum),
-            pdc_swidth, pdc_sheight, SDL_WINDOW_RESIZABLE);
+        if (pdc_headless)
+            pdc_window = SDL_CreateWindow("PDCurses",
+                SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                pdc_swidth, pdc_sheight, 0);
+        else
+            pdc_window = SDL_CreateWindow("PDCurses",
+                SDL_WINDOWPOS_CENTERED_DISPLAY(displaynum),
+                SDL_WINDOWPOS_CENTERED_DISPLAY(displaynum),
+                pdc_swidth, pdc_sheight, SDL_WINDOW_RESIZABLE |
+                (pdc_sdl_present_mode == PDC_SDL_PRESENT_TEXTURE ?
+                                         SDL_WINDOW_ALLOW_HIGHDPI : 0));
 
         if (pdc_window == NULL)
         {
@@ -368,7 +462,21 @@ int PDC_scr_open(void)
             return ERR;
         }
 
-        SDL_SetWindowIcon(pdc_window, pdc_icon);
+        if (pdc_icon)
+            SDL_SetWindowIcon(pdc_window, pdc_icon);
+
+        /* with no flags, SDL picks an accelerated renderer if there is
+           one, else the software one;  SDL_RENDER_DRIVER can override */
+
+        if (pdc_sdl_present_mode == PDC_SDL_PRESENT_TEXTURE && !pdc_screen
+            && !pdc_headless)
+        {
+            pdc_renderer = SDL_CreateRenderer(pdc_window, -1, 0);
+
+            if (!pdc_renderer)
+                fprintf(stderr, "Could not create SDL renderer: %s\n",
+                        SDL_GetError());
+        }
     }
 
     /* Events must be pumped before calling SDL_GetWindowSurface, or
@@ -385,7 +493,7 @@ int PDC_scr_open(void)
 
     if( !pdc_screen)
     {
-        pdc_screen = SDL_GetWindowSurface(pdc_window);
+        pdc_screen = PDC_get_screen_surface();
 
         if( !pdc_screen)
         {
@@ -439,24 +547,28 @@ int PDC_resize_screen(int nlines, int ncols)
     if (nlines && ncols)
     {
 #if SDL_VERSION_ATLEAST(2, 0, 5)
-        SDL_Rect max;
-        int top, left, bottom, right;
-
-        SDL_GetDisplayUsableBounds(0, &max);
-        SDL_GetWindowBordersSize(pdc_window, &top, &left, &bottom, &right);
-        max.h -= top + bottom;
-        max.w -= left + right;
-
-        while (nlines * pdc_fheight > max.h)
-            nlines--;
-        while (ncols * pdc_fwidth > max.w)
-            ncols--;
+        if (!pdc_headless)
+        {
+            SDL_Rect max;
+            int top, left, bottom, right;
+
+            SDL_GetDisplayUsableBounds(0, &max);
+            SDL_GetWindowBordersSize(pdc_window, &top, &left, &bottom,
+                                     &right);
+            max.h -= top + bottom;
+            max.w -= left + right;
+
+            while (nlines * pdc_fheight > max.h)
+                nlines--;
+            while (ncols * pdc_fwidth > max.w)
+                ncols--;
+        }
 #endif
         pdc_sheight = nlines * pdc_fheight;
         pdc_swidth = ncols * pdc_fwidth;
 
         SDL_SetWindowSize(pdc_window, pdc_swidth, pdc_sheight);
-        pdc_screen = SDL_GetWindowSurface(pdc_window);
+        pdc_screen = PDC_get_screen_surface();
     }
 
     if (pdc_tileback)
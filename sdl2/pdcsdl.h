@@ -25,12 +25,18 @@ PDCEX  int pdc_font_size;
 
 PDCEX int pdc_sdl_render_mode;
 #endif
+#define PDC_SDL_PRESENT_SURFACE 1
+#define PDC_SDL_PRESENT_TEXTURE 2
+
+PDCEX int pdc_sdl_present_mode;
 PDCEX  SDL_Window *pdc_window;
 PDCEX  SDL_Surface *pdc_screen, *pdc_font, *pdc_icon, *pdc_back;
 PDCEX  int pdc_sheight, pdc_swidth, pdc_yoffset, pdc_xoffset;
 
 extern SDL_Surface *pdc_tileback;    /* used to regenerate the background
                                         of "transparent" cells */
+extern SDL_Renderer *pdc_renderer;   /* with PDC_SDL_PRESENT_TEXTURE, */
+extern SDL_Texture *pdc_texture;     /* what pdc_screen is shown with */
 extern int pdc_fheight, pdc_fwidth;  /* font height and width */
 extern int pdc_fthick;               /* thickness for highlights and
                                         rendered ACS glyphs */
@@ -39,9 +45,19 @@ extern int pdc_flastc;               /* font palette's last color
 extern bool pdc_own_window;          /* if pdc_window was not set
                                         before initscr(), PDCurses is
                                         responsible for (owns) it */
+extern bool pdc_headless;            /* under the "dummy" or "offscreen"
+                                        video driver;  pdc_screen is
+                                        then never shown */
 
 PDCEX  void PDC_update_rects(void);
 PDCEX  void PDC_retile(void);
+PDCEX  void PDC_sdl_capture_frame(void (*callback)(SDL_Surface *screen,
+                                                   void *data), void *data);
 
 extern void PDC_pump_and_peep(void);
 extern void PDC_blink_text(void);
+extern void PDC_free_dirty_spans(void);
+extern SDL_Surface *PDC_get_screen_surface(void);
+#ifdef PDC_WIDE
+extern void PDC_free_glyph_atlas(void);
+#endif
@@ -0,0 +1,152 @@
+/* Headless smoke test: PDCurses is started under SDL's "dummy" video
+   driver (unless SDL_VIDEODRIVER already names one), a few cells are
+   drawn, and the frame passed to the PDC_sdl_capture_frame() callback
+   is checked pixel by pixel. No display is needed, and the exit status
+   is non-zero if any check failed, so that this can be run by ctest.
+
+   In the wide-character build, PDC_FONT must name a TrueType font (see
+   "Running headless" in README.md).
+*/
+
+#define SDL_MAIN_HANDLED
+
+#include <SDL.h>
+#include <curses.h>
+#include <stdio.h>
+
+#include "pdcsdl.h"
+
+/* what the callback found in the captured frame */
+
+static int _cell_width, _cell_height;
+
+struct frame_check
+{
+    int n_frames;
+    bool background_ok;      /* cell (0, 0): all the background color */
+    bool untouched_ok;       /* cell (0, 1): all black */
+    bool glyph_ok;           /* cell (1, 0): both colors (and, for
+                                bitmap fonts, no others) */
+};
+
+static Uint32 _get_pixel(SDL_Surface *surface, int x, int y)
+{
+    const Uint8 *p = (const Uint8 *)surface->pixels + y * surface->pitch
+                     + x * surface->format->BytesPerPixel;
+
+    switch (surface->format->BytesPerPixel)
+    {
+    case 1:
+        return *p;
+    case 2:
+        return *(const Uint16 *)p;
+    case 3:
+        return (SDL_BYTEORDER == SDL_BIG_ENDIAN) ?
+               (Uint32)(p[0] << 16 | p[1] << 8 | p[2]) :
+               (Uint32)(p[0] | p[1] << 8 | p[2] << 16);
+    default:
+        return *(const Uint32 *)p;
+    }
+}
+
+/* counts the pixels of cell (line, col) that are (or aren't) the
+   given color */
+
+static int _count_pixels(SDL_Surface *screen, int line, int col,
+                         Uint8 r, Uint8 g, Uint8 b, bool matching)
+{
+    int x, y, count = 0;
+
+    for (y = line * _cell_height; y < (line + 1) * _cell_height; y++)
+        for (x = col * _cell_width; x < (col + 1) * _cell_width; x++)
+        {
+            Uint8 pr, pg, pb;
+
+            SDL_GetRGB(_get_pixel(screen, x + pdc_xoffset, y + pdc_yoffset),
+                       screen->format, &pr, &pg, &pb);
+            if ((pr == r && pg == g && pb == b) == matching)
+                count++;
+        }
+
+    return count;
+}
+
+static void _check_frame(SDL_Surface *screen, void *data)
+{
+    struct frame_check *check = (struct frame_check *)data;
+    int n_fore, n_back;
+
+    check->n_frames++;
+
+    if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) < 0)
+        return;
+
+    check->background_ok =
+        !_count_pixels(screen, 0, 0, 0, 0, 255, FALSE);
+    check->untouched_ok =
+        !_count_pixels(screen, 0, 1, 0, 0, 0, FALSE);
+
+    n_fore = _count_pixels(screen, 1, 0, 255, 255, 0, TRUE);
+    n_back = _count_pixels(screen, 1, 0, 0, 0, 255, TRUE);
+    check->glyph_ok = (n_fore && n_back);
+#ifndef PDC_WIDE
+    /* bitmap glyphs have no antialiased edges */
+    check->glyph_ok = (check->glyph_ok
+                       && n_fore + n_back == _cell_width * _cell_height);
+#endif
+
+    if (SDL_MUSTLOCK(screen))
+        SDL_UnlockSurface(screen);
+}
+
+int main(void)
+{
+    struct frame_check check = { 0, FALSE, FALSE, FALSE };
+    int n_failures = 0;
+
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+
+    if (!initscr())
+        return 1;
+
+    _cell_width = pdc_swidth / COLS;
+    _cell_height = pdc_sheight / LINES;
+    curs_set(0);
+    start_color();
+    init_color(COLOR_BLUE, 0, 0, 1000);
+    init_color(COLOR_YELLOW, 1000, 1000, 0);
+    init_pair(1, COLOR_YELLOW, COLOR_BLUE);
+    PDC_sdl_capture_frame(_check_frame, &check);
+
+    attrset(COLOR_PAIR(1));
+    mvaddch(0, 0, ' ');
+    mvaddch(1, 0, 'W');
+    refresh();
+
+    PDC_sdl_capture_frame(NULL, NULL);
+    endwin();
+
+    if (!check.n_frames)
+    {
+        printf("FAILED: no frame captured\n");
+        n_failures++;
+    }
+    if (!check.background_ok)
+    {
+        printf("FAILED: background color not filled in\n");
+        n_failures++;
+    }
+    if (!check.untouched_ok)
+    {
+        printf("FAILED: untouched cell not black\n");
+        n_failures++;
+    }
+    if (!check.glyph_ok)
+    {
+        printf("FAILED: glyph not drawn in its colors\n");
+        n_failures++;
+    }
+
+    printf("%d check(s) failed\n", n_failures);
+    return n_failures ? 1 : 0;
+}
@@ -139,50 +139,164 @@ const chtype MAX_UNICODE = 0x110000;
    int PDC_expand_combined_characters( const cchar_t c, cchar_t *added);  /* addch.c */
 #endif
 
-static void color_string( char *otext, const PACKED_RGB rgb)
+/* If the terminal can't take RGB values directly,  colors are mapped to
+its palette:  the 6x6x6 color cube and 24 grays of a 256-color xterm,  or
+the eight normal ANSI colors.  The nearest match is found once per color
+reduced to fifteen bits (five each of red,  green,  and blue),  for a
+32K-entry table built by PDC_init_color_lut() at startup.  "Nearest" is
+by the "redmean" weighted distance,  a cheap and decent approximation
+to perceived color difference. */
+
+#ifndef PACK_RGB
+   #define PACK_RGB( red, green, blue) ((red) | ((green)<<8) | ((PACKED_RGB)(blue) << 16))
+#endif
+
+#define RGB555_IDX( rgb) ((((rgb) >> 3) & 0x1f) | (((rgb) >> 6) & 0x3e0) \
+                                         | (((rgb) >> 9) & 0x7c00))
+
+static unsigned char *color_lut;
+
+static long color_distance( const PACKED_RGB c1, const PACKED_RGB c2)
 {
-   extern bool PDC_has_rgb_color;      /* pdcscrn.c */
-   const int red = Get_RValue( rgb);
-   const int green = Get_GValue( rgb);
-   const int blue = Get_BValue( rgb);
+   const long rmean = (Get_RValue( c1) + Get_RValue( c2)) / 2;
+   const long dr = Get_RValue( c1) - Get_RValue( c2);
+   const long dg = Get_GValue( c1) - Get_GValue( c2);
+   const long db = Get_BValue( c1) - Get_BValue( c2);
 
-   if( PDC_has_rgb_color)
-      sprintf( otext, "2;%d;%d;%dm", red, green, blue);
-   else
+   return( (((512 + rmean) * dr * dr) >> 8) + 4 * dg * dg
+                  + (((767 - rmean) * db * db) >> 8));
+}
+
+   /* Colors 0-7 of a terminal are in ANSI order (red = 1,  blue = 4),
+   which is not necessarily the order of the COLOR_xxx constants. */
+
+static PACKED_RGB ansi_color( const int idx)
+{
+   return( PACK_RGB( ((idx & 1) ? 0xc0 : 0), ((idx & 2) ? 0xc0 : 0),
+                     ((idx & 4) ? 0xc0 : 0)));
+}
+
+   /* COLORS is 16 only on ANSI.SYS and its relatives,  which know just
+   SGR 30-37 and 40-47;  so only the eight normal colors are candidates.
+   Brightness comes from bold and blink,  as set for A_BOLD and A_BLINK
+   in PDC_transform_line(). */
+
+static int nearest_ansi_color_idx( const PACKED_RGB rgb)
+{
+   long best_dist = color_distance( rgb, ansi_color( 0)), dist;
+   int i, rval = 0;
+
+   for( i = 1; i < 8; i++)
+      if( best_dist > (dist = color_distance( rgb, ansi_color( i))))
+         {
+         best_dist = dist;
+         rval = i;
+         }
+   return( rval);
+}
+
+   /* Only the two cube levels bracketing each of red,  green,  and blue,
+   and the three grays nearest the average,  need be tried. */
+
+static int nearest_xterm256_idx( const PACKED_RGB rgb)
+{
+   static const int levels[6] = { 0, 95, 135, 175, 215, 255 };
+   int lo[3], i, j, rval = 16;
+   long best_dist = -1, dist;
+
+   for( i = 0; i < 3; i++)
       {
-      int idx;
+      const int value = (int)( (rgb >> (i * 8)) & 0xff);
 
-      if( red == green && red == blue)   /* gray scale: indices from */
+      lo[i] = 0;
+      while( lo[i] < 4 && levels[lo[i] + 1] <= value)
+         lo[i]++;
+      }
+   for( i = 0; i < 8; i++)
+      {
+      const int r = lo[0] + (i & 1), g = lo[1] + ((i >> 1) & 1);
+      const int b = lo[2] + (i >> 2);
+
+      dist = color_distance( rgb, PACK_RGB( levels[r], levels[g], levels[b]));
+      if( best_dist < 0 || dist < best_dist)
          {
-         if( red < 27)     /* this would underflow; remap to black */
-            idx = COLOR_BLACK;
-         else if( red >= 243)    /* this would overflow */
-            idx = COLOR_WHITE;
-         else
-            idx = (red - 3) / 10 + 232;     /* 232 to 255 */
+         best_dist = dist;
+         rval = 16 + r * 36 + g * 6 + b;
          }
-      else
-         idx = ((blue - 35) / 40) + ((green - 35) / 40) * 6
-                  + ((red - 35) / 40) * 36 + 16;
+      }
+   i = ((Get_RValue( rgb) + Get_GValue( rgb) + Get_BValue( rgb)) / 3 - 3) / 10;
+   for( j = i - 1; j <= i + 1; j++)
+      if( j >= 0 && j < 24)
+         {
+         const int gray = j * 10 + 8;
+
+         dist = color_distance( rgb, PACK_RGB( gray, gray, gray));
+         if( dist < best_dist)
+            {
+            best_dist = dist;
+            rval = 232 + j;
+            }
+         }
+   return( rval);
+}
+
+static int palette_idx( const PACKED_RGB rgb)
+{
+   if( color_lut)
+      return( color_lut[RGB555_IDX( rgb)]);
+   return( COLORS == 16 ? nearest_ansi_color_idx( rgb)
+                        : nearest_xterm256_idx( rgb));
+}
+
+int PDC_init_color_lut( void)
+{
+   extern bool PDC_has_rgb_color;      /* pdcscrn.c */
+   int i;
+
+   PDC_free_color_lut( );
+   if( PDC_has_rgb_color)
+      return( 0);
+   color_lut = (unsigned char *)malloc( 32768);
+   if( !color_lut)      /* colors will be matched one by one */
+      return( -1);
+   for( i = 0; i < 32768; i++)
+      {
+      const int r = i & 0x1f, g = (i >> 5) & 0x1f, b = i >> 10;
+      const PACKED_RGB rgb = PACK_RGB( (r << 3) | (r >> 2),
+                        (g << 3) | (g >> 2), (b << 3) | (b >> 2));
 
-      sprintf( otext, "5;%dm", idx);
+      color_lut[i] = (unsigned char)( COLORS == 16 ?
+                  nearest_ansi_color_idx( rgb) : nearest_xterm256_idx( rgb));
       }
+   return( 0);
+}
+
+void PDC_free_color_lut( void)
+{
+   free( color_lut);
+   color_lut = NULL;
+}
+
+static void color_string( char *otext, const PACKED_RGB rgb)
+{
+   extern bool PDC_has_rgb_color;      /* pdcscrn.c */
+
+   if( PDC_has_rgb_color)
+      sprintf( otext, "2;%d;%d;%dm", Get_RValue( rgb), Get_GValue( rgb),
+                                     Get_BValue( rgb));
+   else
+      sprintf( otext, "5;%dm", palette_idx( rgb));
 }
 
-static int get_sixteen_color_idx( const PACKED_RGB rgb)
+   /* Sixteen-color (ANSI.SYS-style) consoles get SGR 30-37 or 40-47. */
+
+static void ansi_color_string( char *otext, const PACKED_RGB rgb,
+                               const bool background)
 {
-    int rval = 0;
-
-    if( rgb & 0x80)    /* red value >= 128 */
-        rval = 1;
-    if( rgb & 0x8000)      /* green value >= 128 */
-        rval |= 2;
-    if( rgb & 0x800000)        /* blue value >= 128 */
-        rval |= 4;
-    return( rval);
+   sprintf( otext, "\033[%d%dm", (background ? 4 : 3), palette_idx( rgb));
 }
 
-static void reset_color( char *obuff, const chtype ch)
+static void reset_color( char *obuff, const chtype ch, const uint32_t *cell_rgb)
 {
     static PACKED_RGB prev_bg = (PACKED_RGB)-2;
     static PACKED_RGB prev_fg = (PACKED_RGB)-2;
@@ -193,7 +307,7 @@ static void reset_color( char *obuff, const chtype ch)
         prev_bg = prev_fg = (PACKED_RGB)-2;
         return;
         }
-    PDC_get_rgb_values( ch, &fg, &bg);
+    PDC_get_cell_rgb_values( ch, cell_rgb, &fg, &bg);
     *obuff = '\0';
     if( bg != prev_bg)
         {
@@ -202,7 +316,7 @@ static void reset_color( char *obuff, const chtype ch)
         else if( !bg)
             strcpy( obuff, "\033[40m");
         else if( COLORS == 16)
-            sprintf( obuff, "\033[4%dm", get_sixteen_color_idx( bg));
+            ansi_color_string( obuff, bg, TRUE);
         else
             {
             strcpy( obuff, "\033[48;");
@@ -217,7 +331,7 @@ static void reset_color( char *obuff, const chtype ch)
         if( fg == (PACKED_RGB)-1)   /* default foreground */
             strcpy( obuff, "\033[39m");
         else if( COLORS == 16)
-            sprintf( obuff, "\033[3%dm", get_sixteen_color_idx( fg));
+            ansi_color_string( obuff, fg, FALSE);
         else
             {
             strcpy( obuff, "\033[38;");
@@ -236,6 +350,8 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
     static chtype prev_ch = 0;
     static bool force_reset_all_attribs = TRUE;
     char obuff[OBUFF_SIZE];
+    int stride;
+    const uint32_t *cell_rgb;
 
     if( !srcp)
     {
@@ -249,11 +365,14 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
     assert( lineno >= 0);
     assert( lineno < SP->lines);
     assert( len > 0);
+    cell_rgb = PDC_rgb_plane( curscr, &stride, FALSE);
+    if( cell_rgb)
+        cell_rgb += lineno * stride + x * 2;
     PDC_gotoyx( lineno, x);
     if( force_reset_all_attribs || (!x && !lineno))
     {
         force_reset_all_attribs = FALSE;
-        reset_color( NULL, 0);
+        reset_color( NULL, 0, NULL);
         prev_ch = ~*srcp;
     }
     while( len)
@@ -272,7 +391,7 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
           prev_ch = 0;
           changes = *srcp | A_COLOR;
           strcpy( obuff, RESET_ATTRS);
-          reset_color( NULL, 0);
+          reset_color( NULL, 0, NULL);
        }
        if( SP->termattrs & *srcp & A_BOLD)
           strcat( obuff, BOLD_ON);
@@ -288,8 +407,9 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 #endif
        if( SP->termattrs & changes & A_BLINK)
           strcat( obuff, (*srcp & A_BLINK) ? BLINK_ON : BLINK_OFF);
-       if( changes & (A_COLOR | A_STANDOUT | A_BLINK | A_REVERSE))
-          reset_color( obuff + strlen( obuff), *srcp & ~A_REVERSE);
+       if( (changes & (A_COLOR | A_STANDOUT | A_BLINK | A_REVERSE))
+                     || ((changes | *srcp) & PDC_RGB_CELL))
+          reset_color( obuff + strlen( obuff), *srcp & ~A_REVERSE, cell_rgb);
        PDC_puts_to_stdout( obuff);
 #ifdef USING_COMBINING_CHARACTER_SCHEME
        if( ch > (int)MAX_UNICODE)      /* chars & fullwidth supported */
@@ -319,6 +439,7 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
        {
            bytes_out = PDC_wc_to_utf8( obuff, (wchar_t)ch);
            while( count < len && !((srcp[0] ^ srcp[count]) & ~A_CHARTEXT)
+                        && !(srcp[count] & PDC_RGB_CELL)
                         && (ch = (srcp[count] & A_CHARTEXT)) < (int)MAX_UNICODE)
            {
                if( _is_altcharset( srcp[count]))
@@ -339,6 +460,8 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
        prev_ch = *srcp;
        srcp += count;
        len -= count;
+       if( cell_rgb)
+          cell_rgb += count * 2;
    }
 }
 
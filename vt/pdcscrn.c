@@ -201,6 +201,7 @@ void PDC_scr_close( void)
 void PDC_scr_free( void)
 {
     PDC_free_palette( );
+    PDC_free_color_lut( );
 #ifdef USING_COMBINING_CHARACTER_SCHEME
     PDC_expand_combined_characters( 0, NULL);
 #endif
@@ -282,6 +283,7 @@ int PDC_scr_open(void)
     COLORS = (PDC_is_ansi ? 16 : 256);
     if( PDC_has_rgb_color)
        COLORS = 256 + (256 * 256 * 256);
+    PDC_init_color_lut( );
     assert( SP);
     if (!SP || PDC_init_palette( ))
         return ERR;
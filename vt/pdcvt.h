@@ -24,3 +24,5 @@ extern int PDC_is_ansi;
 #endif
 
 void PDC_puts_to_stdout( const char *buff);        /* pdcdisp.c */
+int PDC_init_color_lut( void);                     /* pdcdisp.c */
+void PDC_free_color_lut( void);                    /* pdcdisp.c */
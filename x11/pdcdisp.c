@@ -2,7 +2,13 @@
 
 #include "pdcx11.h"
 
+#include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_XSHM
+# include <sys/ipc.h>
+# include <sys/shm.h>
+# include <X11/extensions/XShm.h>
+#endif
 
 #ifdef PDC_WIDE
    #define USE_UNICODE_ACS_CHARS 1
@@ -17,6 +23,379 @@ bool pdc_blinked_off;
 bool pdc_visible_cursor = FALSE;
 bool pdc_vertical_cursor = FALSE;
 
+/* Everything is drawn into a pixmap the size of the window, and the
+   changed area (the bounding box of everything drawn since the last
+   PDC_update_window()) copied from there to the window. Exposes then
+   only need a copy, not a redraw. */
+
+static Pixmap _backing = None;
+static GC _copy_gc = NULL;
+static int _backing_width, _backing_height;
+static int _damage_x1, _damage_y1, _damage_x2 = 0, _damage_y2 = 0;
+
+static GC _get_copy_gc(void)
+{
+    if (!_copy_gc)
+    {
+        XGCValues values;
+
+        values.graphics_exposures = False;
+        _copy_gc = XCreateGC(XCURSESDISPLAY, XCURSESWIN,
+                             GCGraphicsExposures, &values);
+    }
+
+    return _copy_gc;
+}
+
+/* The pixmap to draw on -- (re)created as needed to match the size of
+   the window. On a resize, what was drawn so far is carried over, so
+   that exposes don't show black until curses has repainted everything */
+
+static Drawable _drawable(void)
+{
+    if (!_backing || _backing_width != pdc_wwidth
+                  || _backing_height != pdc_wheight)
+    {
+        Pixmap old_backing = _backing;
+        Cardinal depth = 0;
+
+        XtVaGetValues(pdc_drawing, XtNdepth, &depth, NULL);
+        _backing = XCreatePixmap(XCURSESDISPLAY, XCURSESWIN, pdc_wwidth,
+                                 pdc_wheight, depth);
+
+        XSetForeground(XCURSESDISPLAY, _get_copy_gc(),
+                       BlackPixelOfScreen(XtScreen(pdc_drawing)));
+        XFillRectangle(XCURSESDISPLAY, _backing, _copy_gc, 0, 0,
+                       pdc_wwidth, pdc_wheight);
+
+        if (old_backing)
+        {
+            XCopyArea(XCURSESDISPLAY, old_backing, _backing, _copy_gc, 0, 0,
+                      min(_backing_width, pdc_wwidth),
+                      min(_backing_height, pdc_wheight), 0, 0);
+            XFreePixmap(XCURSESDISPLAY, old_backing);
+        }
+
+        _backing_width = pdc_wwidth;
+        _backing_height = pdc_wheight;
+    }
+
+    return _backing;
+}
+
+/* With the textRendering resource set to "image", cells are instead
+   rasterized by PDCurses itself, into an XImage the size of the window
+   -- in shared memory (MIT-SHM), if the server can attach it, which it
+   can't for remote displays -- and the changed area put from there to
+   the window. Glyphs are drawn by the server once each, and cached here
+   as bitmaps. This only handles 32-bit TrueColor images in our own byte
+   order; for anything else, or if we were built without MIT-SHM, the
+   core drawing is used. */
+
+static XImage *_image = NULL;
+static bool _image_off = FALSE;
+
+#define IMAGE_ROW(y) \
+    ((uint32_t *)(_image->data + (y) * _image->bytes_per_line))
+
+#ifdef HAVE_XSHM
+static XShmSegmentInfo _shm_info;
+static bool _image_shm = FALSE, _shm_busy = FALSE;
+static bool _shm_error;
+
+static int _shm_error_handler(Display *display, XErrorEvent *error)
+{
+    INTENTIONALLY_UNUSED_PARAMETER( display);
+    INTENTIONALLY_UNUSED_PARAMETER( error);
+
+    _shm_error = TRUE;
+    return 0;
+}
+
+static void _destroy_image(XImage *image, const bool shm,
+                           XShmSegmentInfo *shm_info)
+{
+    if (shm)
+    {
+        XShmDetach(XCURSESDISPLAY, shm_info);
+        image->data = NULL;
+        XDestroyImage(image);
+        shmdt(shm_info->shmaddr);
+    }
+    else
+        XDestroyImage(image);       /* frees the data, too */
+}
+
+static void _free_image(void)
+{
+    if (!_image)
+        return;
+
+    _destroy_image(_image, _image_shm, &_shm_info);
+    _image = NULL;
+    _image_shm = _shm_busy = FALSE;
+}
+
+static void _create_shm_image(Visual *visual, const int depth)
+{
+    Display *display = XCURSESDISPLAY;
+
+    _image = XShmCreateImage(display, visual, depth, ZPixmap, NULL,
+                             &_shm_info, pdc_wwidth, pdc_wheight);
+    if (!_image)
+        return;
+
+    _shm_info.shmid = shmget(IPC_PRIVATE,
+                             _image->bytes_per_line * _image->height,
+                             IPC_CREAT | 0600);
+    _shm_info.shmaddr = (_shm_info.shmid < 0 ? (char *)-1 :
+                         (char *)shmat(_shm_info.shmid, NULL, 0));
+
+    if (_shm_info.shmaddr != (char *)-1)
+    {
+        XErrorHandler old_handler = XSetErrorHandler(_shm_error_handler);
+
+        _image->data = _shm_info.shmaddr;
+        _shm_info.readOnly = False;
+        _shm_error = FALSE;
+        XShmAttach(display, &_shm_info);
+
+        /* the only way to find out if that worked */
+
+        XSync(display, False);
+        XSetErrorHandler(old_handler);
+
+        _image_shm = !_shm_error;
+        if (!_image_shm)
+            shmdt(_shm_info.shmaddr);
+    }
+
+    /* the segment goes away once both sides have detached */
+
+    if (_shm_info.shmid >= 0)
+        shmctl(_shm_info.shmid, IPC_RMID, NULL);
+
+    if (!_image_shm)
+    {
+        _image->data = NULL;
+        XDestroyImage(_image);
+        _image = NULL;
+    }
+}
+
+static bool _create_image(void)
+{
+    Visual *visual = DefaultVisualOfScreen(XtScreen(pdc_drawing));
+    const int one = 1;
+    Cardinal depth = 0;
+
+    if (visual->class != TrueColor || visual->red_mask != 0xff0000
+        || visual->green_mask != 0xff00 || visual->blue_mask != 0xff)
+        return FALSE;
+
+    XtVaGetValues(pdc_drawing, XtNdepth, &depth, NULL);
+
+    if (XShmQueryExtension(XCURSESDISPLAY))
+        _create_shm_image(visual, (int)depth);
+
+    if (!_image)
+    {
+        _image = XCreateImage(XCURSESDISPLAY, visual, depth, ZPixmap, 0,
+                              NULL, pdc_wwidth, pdc_wheight, 32, 0);
+        if (!_image)
+            return FALSE;
+
+        _image->data = malloc(_image->bytes_per_line * _image->height);
+    }
+
+    if (!_image->data || _image->bits_per_pixel != 32 ||
+        _image->byte_order != (*(const char *)&one ? LSBFirst : MSBFirst))
+    {
+        _free_image();
+        return FALSE;
+    }
+
+    memset(_image->data, 0, _image->bytes_per_line * _image->height);
+    return TRUE;
+}
+
+/* Are we drawing into the image? If so, make sure it's the right size
+   -- on a resize, carrying over what was drawn so far, so that exposes
+   don't show black until curses has repainted everything -- and that
+   the server's done reading the last lot from shared memory before
+   anything changes there */
+
+static bool _use_image(void)
+{
+    if (_image_off)
+        return FALSE;
+
+    if (!_image && strcmp(pdc_app_data.textRendering, "image"))
+    {
+        _image_off = TRUE;
+        return FALSE;
+    }
+
+    if (_image && (_image->width != pdc_wwidth
+                   || _image->height != pdc_wheight))
+    {
+        XImage *old_image = _image;
+        XShmSegmentInfo old_shm_info = _shm_info;
+        const bool old_shm = _image_shm;
+
+        if (_shm_busy)
+            XSync(XCURSESDISPLAY, False);
+
+        _image = NULL;
+        _image_shm = _shm_busy = FALSE;
+
+        if (_create_image())
+        {
+            const int width = min(old_image->width, _image->width);
+            const int height = min(old_image->height, _image->height);
+            int y;
+
+            for (y = 0; y < height; y++)
+                memcpy(IMAGE_ROW(y), old_image->data
+                       + y * old_image->bytes_per_line,
+                       width * sizeof(uint32_t));
+        }
+
+        _destroy_image(old_image, old_shm, &old_shm_info);
+    }
+
+    if (!_image && !_create_image())
+    {
+        _image_off = TRUE;
+        return FALSE;
+    }
+
+    if (_shm_busy)
+    {
+        XSync(XCURSESDISPLAY, False);
+        _shm_busy = FALSE;
+    }
+
+    return TRUE;
+}
+#else
+static void _free_image(void)
+{
+}
+
+static bool _use_image(void)
+{
+    return FALSE;
+}
+#endif
+
+static void _put_image(int x, int y, int width, int height)
+{
+    width = min(width, _image->width - x);
+    height = min(height, _image->height - y);
+
+    if (width <= 0 || height <= 0)
+        return;
+
+#ifdef HAVE_XSHM
+    if (_image_shm)
+    {
+        XShmPutImage(XCURSESDISPLAY, XCURSESWIN, _get_copy_gc(), _image,
+                     x, y, x, y, width, height, False);
+        _shm_busy = TRUE;
+        return;
+    }
+#endif
+    XPutImage(XCURSESDISPLAY, XCURSESWIN, _get_copy_gc(), _image,
+              x, y, x, y, width, height);
+}
+
+static void _image_fill(int x, int y, int width, int height,
+                        const Pixel color)
+{
+    int i;
+
+    width = min(width, _image->width - x);
+    height = min(height, _image->height - y);
+
+    for (; height > 0; height--, y++)
+    {
+        uint32_t *pixel = IMAGE_ROW(y) + x;
+
+        for (i = 0; i < width; i++)
+            pixel[i] = (uint32_t)color;
+    }
+}
+
+static void _image_invert(int x, int y, int width, int height)
+{
+    int i;
+
+    width = min(width, _image->width - x);
+    height = min(height, _image->height - y);
+
+    for (; height > 0; height--, y++)
+    {
+        uint32_t *pixel = IMAGE_ROW(y) + x;
+
+        for (i = 0; i < width; i++)
+            pixel[i] ^= 0xffffff;
+    }
+}
+
+static void _add_damage(const int x, const int y, const int width,
+                        const int height)
+{
+    if (_damage_x2 <= _damage_x1)
+    {
+        _damage_x1 = x;
+        _damage_y1 = y;
+        _damage_x2 = x + width;
+        _damage_y2 = y + height;
+    }
+    else
+    {
+        _damage_x1 = min(_damage_x1, x);
+        _damage_y1 = min(_damage_y1, y);
+        _damage_x2 = max(_damage_x2, x + width);
+        _damage_y2 = max(_damage_y2, y + height);
+    }
+}
+
+/* copy what's been drawn since the last call to the window */
+
+void PDC_update_window(void)
+{
+    if (_damage_x2 > _damage_x1)
+    {
+        if (_image)
+            _put_image(_damage_x1, _damage_y1, _damage_x2 - _damage_x1,
+                       _damage_y2 - _damage_y1);
+        else if (_backing)
+            XCopyArea(XCURSESDISPLAY, _backing, XCURSESWIN, _get_copy_gc(),
+                      _damage_x1, _damage_y1, _damage_x2 - _damage_x1,
+                      _damage_y2 - _damage_y1, _damage_x1, _damage_y1);
+    }
+
+    _damage_x1 = _damage_x2 = 0;
+}
+
+/* For an Expose:  copy the given area from the pixmap (or image), if
+   there's anything in it yet */
+
+bool PDC_copy_from_backing(int x, int y, int width, int height)
+{
+    if (_image)
+        _put_image(x, y, width, height);
+    else if (_backing)
+        XCopyArea(XCURSESDISPLAY, _backing, XCURSESWIN, _get_copy_gc(),
+                  x, y, width, height, x, y);
+    else
+        return FALSE;
+
+    return TRUE;
+}
+
 /* Convert character positions x and y to pixel positions, stored in
    xpos and ypos */
 
@@ -88,12 +467,15 @@ static void _display_cursor(int old_row, int old_x, int new_row, int new_x)
     ch = curscr->_y[new_row] + new_x;
     _set_cursor_color(ch, &fore, &back);
 
-    if (pdc_vertical_cursor)
+    if (pdc_vertical_cursor && _use_image())       /* as drawn below */
+        _image_fill(xpos + 1, ypos - pdc_app_data.normalFont->ascent,
+                    SP->visibility, pdc_fheight, PDC_get_pixel( back));
+    else if (pdc_vertical_cursor)
     {
         XSetForeground(XCURSESDISPLAY, pdc_cursor_gc, PDC_get_pixel( back));
 
         for (i = 1; i <= SP->visibility; i++)
-            XDrawLine(XCURSESDISPLAY, XCURSESWIN, pdc_cursor_gc,
+            XDrawLine(XCURSESDISPLAY, _drawable(), pdc_cursor_gc,
                       xpos + i, ypos - pdc_app_data.normalFont->ascent,
                       xpos + i, ypos - pdc_app_data.normalFont->ascent +
                       pdc_fheight - 1);
@@ -115,11 +497,18 @@ static void _display_cursor(int old_row, int old_x, int new_row, int new_x)
             yh = pdc_fheight / 4;
         }
 
-        XSetFunction(XCURSESDISPLAY, pdc_cursor_gc, GXinvert);
-        XFillRectangle(XCURSESDISPLAY, XCURSESWIN, pdc_cursor_gc,
-            xpos, yp, pdc_fwidth, yh);
+        if (_use_image())
+            _image_invert(xpos, yp, pdc_fwidth, yh);
+        else
+        {
+            XSetFunction(XCURSESDISPLAY, pdc_cursor_gc, GXinvert);
+            XFillRectangle(XCURSESDISPLAY, _drawable(), pdc_cursor_gc,
+                xpos, yp, pdc_fwidth, yh);
+        }
     }
 
+    _add_damage(xpos, ypos - pdc_fascent, pdc_fwidth, pdc_fheight);
+
     PDC_LOG(("_display_cursor() - draw cursor at row %d col %d\n",
              new_row, new_x));
 }
@@ -129,42 +518,40 @@ void PDC_redraw_cursor(void)
     _display_cursor(SP->cursrow, SP->curscol, SP->cursrow, SP->curscol);
 }
 
-void PDC_blink_text(XtPointer unused, XtIntervalId *id)
+static bool _blink_timer_pending = FALSE;
+
+/* The blink timer runs only while A_BLINK is enabled and some line of
+   the screen holds blinking text (or the text is blinked off, and has to
+   be brought back); PDC_doupdate() starts it when blinking text shows up. */
+
+void PDC_check_blink_timer(void)
 {
-    int row;
-    int j, k;
-    chtype *ch;
+    if (!_blink_timer_pending && (SP->termattrs & A_BLINK)
+                 && (pdc_blinked_off || PDC_n_blinking_lines()))
+    {
+        XtAppAddTimeOut(pdc_app_context, pdc_app_data.textBlinkRate,
+                        PDC_blink_text, NULL);
+        _blink_timer_pending = TRUE;
+    }
+}
 
+void PDC_blink_text(XtPointer unused, XtIntervalId *id)
+{
     INTENTIONALLY_UNUSED_PARAMETER( unused);
     INTENTIONALLY_UNUSED_PARAMETER( id);
     PDC_LOG(("PDC_blink_text() - called:\n"));
 
+    _blink_timer_pending = FALSE;
     PDC_blink_state = pdc_blinked_off = !pdc_blinked_off;
 
-    /* Redraw changed lines on the screen to match the blink state */
-
-    for (row = 0; row < SP->lines; row++)
-    {
-        ch = curscr->_y[row];
-
-        for (j = 0; j < COLS; j++)
-            if (ch[j] & A_BLINK)
-            {
-                k = j;
-                while (ch[k] & A_BLINK && k < COLS)
-                    k++;
+    /* Redraw blinking text on the screen to match the blink state */
 
-                PDC_transform_line(row, j, k - j, ch + j);
-
-                j = k;
-            }
-    }
+    PDC_redraw_blinking_cells();
 
     PDC_redraw_cursor();
+    PDC_update_window();
 
-    if ((SP->termattrs & A_BLINK) || !pdc_blinked_off)
-        XtAppAddTimeOut(pdc_app_context, pdc_app_data.textBlinkRate,
-                        PDC_blink_text, NULL);
+    PDC_check_blink_timer();
 }
 
 static void _toggle_cursor(void)
@@ -221,6 +608,7 @@ void PDC_blink_cursor(XtPointer unused, XtIntervalId *id)
     INTENTIONALLY_UNUSED_PARAMETER( unused);
     INTENTIONALLY_UNUSED_PARAMETER( id);
     _toggle_cursor();
+    PDC_update_window();
     XtAppAddTimeOut(pdc_app_context, pdc_app_data.cursorBlinkRate,
                     PDC_blink_cursor, NULL);
 }
@@ -234,27 +622,342 @@ void PDC_gotoyx(int row, int col)
     PDC_display_cursor(SP->cursrow, SP->curscol, row, col, SP->visibility);
 }
 
+/* GCs for text and for plain drawing (lines and fills) are kept in a
+   small cache, keyed on the style (which font) and colors, so that runs
+   in colors seen recently need no GC changes at all. When full, the
+   least recently used one is changed to suit. */
+
+enum { STYLE_NORMAL, STYLE_ITALIC, STYLE_BOLD, STYLE_PLAIN };
+
+#define GC_CACHE_SIZE 16
+
+static struct
+{
+    GC gc;
+    int style;
+    Pixel fore, back;
+    unsigned long last_used;
+} _gc_cache[GC_CACHE_SIZE];
+
+static int _n_cached_gcs = 0;
+static unsigned long _gc_clock = 0;
+
+/* The italic and bold fonts are only used if they have the same width
+   as the normal one */
+
+static XFontStruct *_style_font(const int style)
+{
+    XFontStruct *font = pdc_app_data.normalFont;
+
+    if (style == STYLE_ITALIC)
+        font = pdc_app_data.italicFont;
+    else if (style == STYLE_BOLD)
+        font = pdc_app_data.boldFont;
+
+    return (font->max_bounds.width == pdc_fwidth ? font
+                                                 : pdc_app_data.normalFont);
+}
+
+/* Text only has to be clipped to its cells if some glyph (or the image
+   text background) of the font extends beyond them */
+
+static bool _style_needs_clip(const int style)
+{
+    const XFontStruct *font = _style_font(style);
+
+    return (style != STYLE_PLAIN
+            && (font->ascent > pdc_fascent || font->descent > pdc_fdescent
+             || font->max_bounds.ascent > pdc_fascent
+             || font->max_bounds.descent > pdc_fdescent
+             || font->min_bounds.lbearing < 0
+             || font->max_bounds.rbearing > pdc_fwidth));
+}
+
+static GC _get_gc(const int style, const Pixel fore, const Pixel back)
+{
+    XGCValues values;
+    const unsigned long mask = GCFont | GCForeground | GCBackground
+                             | GCClipMask;
+    int i, lru = 0;
+
+    for (i = 0; i < _n_cached_gcs; i++)
+    {
+        if (_gc_cache[i].style == style && _gc_cache[i].fore == fore
+                                        && _gc_cache[i].back == back)
+        {
+            _gc_cache[i].last_used = ++_gc_clock;
+            return _gc_cache[i].gc;
+        }
+        if (_gc_cache[i].last_used < _gc_cache[lru].last_used)
+            lru = i;
+    }
+
+    values.font = _style_font(style)->fid;
+    values.foreground = fore;
+    values.background = back;
+    values.clip_mask = None;
+
+    if (_n_cached_gcs < GC_CACHE_SIZE)
+    {
+        lru = _n_cached_gcs++;
+        _gc_cache[lru].gc = XCreateGC(XCURSESDISPLAY, XCURSESWIN, mask,
+                                      &values);
+    }
+    else
+        XChangeGC(XCURSESDISPLAY, _gc_cache[lru].gc, mask, &values);
+
+    _gc_cache[lru].style = style;
+    _gc_cache[lru].fore = fore;
+    _gc_cache[lru].back = back;
+    _gc_cache[lru].last_used = ++_gc_clock;
+
+    return _gc_cache[lru].gc;
+}
+
+void PDC_free_gc_cache(void)
+{
+    while (_n_cached_gcs)
+        XFreeGC(XCURSESDISPLAY, _gc_cache[--_n_cached_gcs].gc);
+}
+
+/* Glyph bitmaps for image rendering, one byte per pixel of the cell,
+   in an open-addressed hash keyed on style and character. Each is got
+   by drawing the character into a 1-bit pixmap and reading it back --
+   a round trip, but only the first time it's seen. When the table
+   fills up, it's simply emptied. */
+
+#define GLYPH_HASH_SIZE 4096
+
+static struct
+{
+    unsigned long key;          /* (style << 16 | character) + 1;  0 if
+                                   the slot's empty */
+    unsigned char *bits;
+} _glyphs[GLYPH_HASH_SIZE];
+
+static int _n_glyphs = 0;
+static Pixmap _glyph_pixmap = None;
+static GC _glyph_gc = NULL;
+
+static void _free_glyphs(void)
+{
+    int i;
+
+    for (i = 0; i < GLYPH_HASH_SIZE; i++)
+        if (_glyphs[i].key)
+        {
+            free(_glyphs[i].bits);
+            _glyphs[i].key = 0;
+        }
+
+    _n_glyphs = 0;
+}
+
+static const unsigned char *_get_glyph(const int style, const unsigned code)
+{
+    Display *display = XCURSESDISPLAY;
+    const unsigned long key = ((unsigned long)style << 16 | code) + 1;
+    unsigned i = (unsigned)(key * 2654435761UL) & (GLYPH_HASH_SIZE - 1);
+    unsigned char *bits;
+    XImage *glyph;
+    int x, y;
+
+    while (_glyphs[i].key)
+    {
+        if (_glyphs[i].key == key)
+            return _glyphs[i].bits;
+        i = (i + 1) & (GLYPH_HASH_SIZE - 1);
+    }
+
+    if (_n_glyphs >= GLYPH_HASH_SIZE * 3 / 4)
+    {
+        _free_glyphs();
+        return _get_glyph(style, code);
+    }
+
+    if (!_glyph_pixmap)
+    {
+        _glyph_pixmap = XCreatePixmap(display, XCURSESWIN, pdc_fwidth,
+                                      pdc_fheight, 1);
+        _glyph_gc = XCreateGC(display, _glyph_pixmap, 0, NULL);
+    }
+
+    XSetFont(display, _glyph_gc, _style_font(style)->fid);
+    XSetForeground(display, _glyph_gc, 0);
+    XFillRectangle(display, _glyph_pixmap, _glyph_gc, 0, 0,
+                   pdc_fwidth, pdc_fheight);
+    XSetForeground(display, _glyph_gc, 1);
+    {
+#ifdef PDC_WIDE
+        XChar2b ch;
+
+        ch.byte1 = (code >> 8) & 0xff;
+        ch.byte2 = code & 0xff;
+        XDrawString16(display, _glyph_pixmap, _glyph_gc, 0, pdc_fascent,
+                      &ch, 1);
+#else
+        char ch = (char)code;
+
+        XDrawString(display, _glyph_pixmap, _glyph_gc, 0, pdc_fascent,
+                    &ch, 1);
+#endif
+    }
+
+    glyph = XGetImage(display, _glyph_pixmap, 0, 0, pdc_fwidth, pdc_fheight,
+                      1, XYPixmap);
+    bits = malloc(pdc_fwidth * pdc_fheight);
+
+    if (!glyph || !bits)
+    {
+        if (glyph)
+            XDestroyImage(glyph);
+        free(bits);
+        return NULL;
+    }
+
+    for (y = 0; y < pdc_fheight; y++)
+        for (x = 0; x < pdc_fwidth; x++)
+            bits[y * pdc_fwidth + x] = (XGetPixel(glyph, x, y) != 0);
+
+    XDestroyImage(glyph);
+
+    _glyphs[i].key = key;
+    _glyphs[i].bits = bits;
+    _n_glyphs++;
+
+    return bits;
+}
+
+#ifdef PDC_WIDE
+static void _image_text(const int xpos, const int top, const XChar2b *text,
+#else
+static void _image_text(const int xpos, const int top, const char *text,
+#endif
+                        const int len, const int style, const Pixel fore,
+                        const Pixel back)
+{
+    const int height = min(pdc_fheight, _image->height - top);
+    int k, x, y;
+
+    for (k = 0; k < len; k++)
+    {
+        const int x0 = xpos + k * pdc_fwidth;
+        const int width = min(pdc_fwidth, _image->width - x0);
+#ifdef PDC_WIDE
+        const unsigned char *bits = _get_glyph(style,
+                              (unsigned)text[k].byte1 << 8 | text[k].byte2);
+#else
+        const unsigned char *bits = _get_glyph(style,
+                                               (unsigned char)text[k]);
+#endif
+
+        if (width <= 0)
+            break;
+
+        if (!bits)
+        {
+            _image_fill(x0, top, width, height, back);
+            continue;
+        }
+
+        for (y = 0; y < height; y++)
+        {
+            uint32_t *pixel = IMAGE_ROW(top + y) + x0;
+            const unsigned char *src = bits + y * pdc_fwidth;
+
+            for (x = 0; x < width; x++)
+                pixel[x] = (uint32_t)(src[x] ? fore : back);
+        }
+    }
+}
+
+void PDC_free_backing(void)
+{
+    _free_image();
+    _free_glyphs();
+    if (_glyph_pixmap)
+        XFreePixmap(XCURSESDISPLAY, _glyph_pixmap);
+    if (_glyph_gc)
+        XFreeGC(XCURSESDISPLAY, _glyph_gc);
+    if (_backing)
+        XFreePixmap(XCURSESDISPLAY, _backing);
+    if (_copy_gc)
+        XFreeGC(XCURSESDISPLAY, _copy_gc);
+    _glyph_pixmap = _backing = None;
+    _glyph_gc = _copy_gc = NULL;
+    _image_off = FALSE;
+}
+
+/* fill a rectangle, e.g. for underlines -- in the image, or on the
+   pixmap */
+
+static void _fill_rect(const Pixel color, const Pixel back, const int x,
+                       const int y, const int width, const int height)
+{
+    if (_image)
+        _image_fill(x, y, width, height, color);
+    else
+        XFillRectangle(XCURSESDISPLAY, _drawable(),
+                       _get_gc(STYLE_PLAIN, color, back),
+                       x, y, width, height);
+}
+
 #define reverse_bytes( rgb) ((rgb >> 16) | (rgb & 0xff00) | ((rgb & 0xff) << 16))
 
+/* Runs of text which need nothing but XDrawImageString() are held back,
+   so that adjacent ones drawn with the same GC -- e.g., differing only
+   in attributes the X11 port doesn't show, or RGB cells of the same
+   colors -- can go out as one request */
+
+#define MAX_PACKET_SIZE 128
+#define MAX_PENDING_TEXT 512
+
+static struct
+{
+    GC gc;
+    int xpos, ypos, len;
+#ifdef PDC_WIDE
+    XChar2b text[MAX_PENDING_TEXT];
+#else
+    char text[MAX_PENDING_TEXT];
+#endif
+} _pending;
+
+static void _flush_text(void)
+{
+    if (_pending.len)
+    {
+#ifdef PDC_WIDE
+        XDrawImageString16(
+#else
+        XDrawImageString(
+#endif
+            XCURSESDISPLAY, _drawable(), _pending.gc, _pending.xpos,
+            _pending.ypos, _pending.text, _pending.len);
+
+        _pending.len = 0;
+    }
+}
+
 /* update the given physical line to look like the corresponding line in
    curscr */
 
 /* Output a block of characters with common attributes */
 
 static int _new_packet(const chtype attr, const int len, const int col, const int row,
+                       const uint32_t *cell_rgb,
 #ifdef PDC_WIDE
                        const XChar2b *text)
 #else
                        const char *text)
 #endif
 {
-    XRectangle bounds;
-    GC gc;
-    int xpos, ypos;
+    int xpos, ypos, top, style;
+    bool image;
     PACKED_RGB fore_rgb, back_rgb;
     attr_t sysattrs;
 
-    PDC_get_rgb_values( attr, &fore_rgb, &back_rgb);
+    PDC_get_cell_rgb_values( attr, cell_rgb, &fore_rgb, &back_rgb);
     fore_rgb = reverse_bytes( fore_rgb);
     back_rgb = reverse_bytes( back_rgb);
 
@@ -262,82 +965,105 @@ static int _new_packet(const chtype attr, const int len, const int col, const in
 
     sysattrs = SP->termattrs;
 
-    /* Determine which GC to use - normal, italic or bold */
+    /* Determine which font to use - normal, italic or bold */
 
     if ((attr & A_ITALIC) && (sysattrs & A_ITALIC))
-        gc = pdc_italic_gc;
+        style = STYLE_ITALIC;
     else if ((attr & A_BOLD) && (sysattrs & A_BOLD))
-        gc = pdc_bold_gc;
+        style = STYLE_BOLD;
     else
-        gc = pdc_normal_gc;
+        style = STYLE_NORMAL;
 
     _make_xy(col, row, &xpos, &ypos);
+    top = ypos - pdc_fascent;
+    _add_damage(xpos, top, pdc_fwidth * len, pdc_fheight);
 
-    bounds.x = xpos;
-    bounds.y = ypos - pdc_fascent;
-    bounds.width = pdc_fwidth * len;
-    bounds.height = pdc_fheight;
-
-    XSetClipRectangles(XCURSESDISPLAY, gc, 0, 0, &bounds, 1, Unsorted);
+    image = _use_image();
 
     if (pdc_blinked_off && (sysattrs & A_BLINK) && (attr & A_BLINK))
     {
-        XSetForeground(XCURSESDISPLAY, gc, (Pixel)fore_rgb);
-        XFillRectangle(XCURSESDISPLAY, XCURSESWIN, gc, xpos, bounds.y,
-                       bounds.width, pdc_fheight);
+        if (!image)
+            _flush_text();
+        _fill_rect((Pixel)fore_rgb, (Pixel)back_rgb, xpos, top,
+                   pdc_fwidth * len, pdc_fheight);
     }
     else
     {
-        /* Draw it */
+        const bool decorated = !!(attr & (A_LEFT | A_RIGHT | A_UNDERLINE
+                                          | A_OVERLINE | A_STRIKEOUT));
 
-        XSetForeground(XCURSESDISPLAY, gc, (Pixel)fore_rgb);
-        XSetBackground(XCURSESDISPLAY, gc, (Pixel)back_rgb);
+        if (image)
+            _image_text(xpos, top, text, len, style, (Pixel)fore_rgb,
+                        (Pixel)back_rgb);
+        else
+        {
+            const bool clip = _style_needs_clip(style);
+            GC gc = _get_gc(style, (Pixel)fore_rgb, (Pixel)back_rgb);
 
-#ifdef PDC_WIDE
-        XDrawImageString16(
-#else
-        XDrawImageString(
-#endif
-            XCURSESDISPLAY, XCURSESWIN, gc, xpos, ypos, text, len);
+            if (_pending.len && (_pending.gc != gc || _pending.ypos != ypos
+                     || _pending.xpos + _pending.len * pdc_fwidth != xpos
+                     || _pending.len + len > MAX_PENDING_TEXT))
+                _flush_text();
 
-        /* Underline, etc. */
+            if (clip)
+            {
+                XRectangle bounds;
 
-        if (attr & (A_LEFT | A_RIGHT | A_UNDERLINE | A_OVERLINE | A_STRIKEOUT))
+                bounds.x = xpos;
+                bounds.y = top;
+                bounds.width = pdc_fwidth * len;
+                bounds.height = pdc_fheight;
+
+                _flush_text();
+                XSetClipRectangles(XCURSESDISPLAY, gc, 0, 0, &bounds, 1,
+                                   Unsorted);
+            }
+
+            /* Draw it (or queue it, to go with the next run) */
+
+            if (!_pending.len)
+            {
+                _pending.gc = gc;
+                _pending.xpos = xpos;
+                _pending.ypos = ypos;
+            }
+            memcpy(_pending.text + _pending.len, text, len * sizeof(*text));
+            _pending.len += len;
+
+            if (decorated || clip)
+                _flush_text();
+        }
+
+        /* Underline, etc. -- kept within the cells */
+
+        if (decorated)
         {
             int k;
-            const int xend = xpos + pdc_fwidth * len;
+            const int width = pdc_fwidth * len;
+            const Pixel line = (SP->line_color != -1 ?
+                                PDC_get_pixel( SP->line_color) :
+                                (Pixel)fore_rgb);
 
-            if (SP->line_color != -1)
-                XSetForeground(XCURSESDISPLAY, gc, PDC_get_pixel( SP->line_color));
-
-            if (attr & A_UNDERLINE)
-                XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                          xpos, ypos + 1, xend, ypos + 1);
+            if ((attr & A_UNDERLINE) && pdc_fdescent > 1)
+                _fill_rect(line, (Pixel)back_rgb, xpos, ypos + 1, width, 1);
 
             if (attr & A_OVERLINE)
-                XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                          xpos, ypos - pdc_fascent, xend,  ypos - pdc_fascent);
+                _fill_rect(line, (Pixel)back_rgb, xpos, top, width, 1);
 
             if (attr & A_STRIKEOUT)
-                XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                          xpos, ypos - pdc_fascent / 2, xend,
-                                ypos - pdc_fascent / 2);
+                _fill_rect(line, (Pixel)back_rgb, xpos,
+                           ypos - pdc_fascent / 2, width, 1);
 
             if (attr & A_LEFT)
                 for (k = 0; k < len; k++)
-                {
-                    int x = xpos + pdc_fwidth * k;
-                    XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                              x, ypos - pdc_fascent, x, ypos + pdc_fdescent);
-                }
+                    _fill_rect(line, (Pixel)back_rgb, xpos + pdc_fwidth * k,
+                               top, 1, pdc_fheight);
 
             if (attr & A_RIGHT)
                 for (k = 0; k < len; k++)
-                {
-                    int x = xpos + pdc_fwidth * (k + 1) - 1;
-                    XDrawLine(XCURSESDISPLAY, XCURSESWIN, gc,
-                              x, ypos - pdc_fascent, x, ypos + pdc_fdescent);
-                }
+                    _fill_rect(line, (Pixel)back_rgb,
+                               xpos + pdc_fwidth * (k + 1) - 1, top, 1,
+                               pdc_fheight);
         }
     }
 
@@ -350,8 +1076,6 @@ static int _new_packet(const chtype attr, const int len, const int col, const in
 
 /* The core display routine -- update one line of text */
 
-#define MAX_PACKET_SIZE 128
-
 void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 {
 #ifdef PDC_WIDE
@@ -360,7 +1084,8 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
     char text[MAX_PACKET_SIZE];
 #endif
     chtype old_attr, attr;
-    int i, j;
+    int i, j, stride;
+    const uint32_t *rgb_row = PDC_rgb_plane( curscr, &stride, FALSE);
 
     PDC_LOG(("PDC_transform_line() - called: lineno: %d x: %d "
              "len: %d\n", lineno, x, len));
@@ -368,13 +1093,15 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
     if (!len)
         return;
 
-    old_attr = *srcp & A_ATTRIBUTES;
+    old_attr = *srcp & (A_ATTRIBUTES | PDC_RGB_CELL);
+    if (rgb_row)
+        rgb_row += lineno * stride;
 
     for (i = 0, j = 0; j < len; j++)
     {
         chtype curr = srcp[j];
 
-        attr = curr & A_ATTRIBUTES;
+        attr = curr & (A_ATTRIBUTES | PDC_RGB_CELL);
 
         if( _is_altcharset( curr))
         {
@@ -391,9 +1118,13 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
             attr ^= A_REVERSE;
         }
 #endif
-        if (attr != old_attr || i == MAX_PACKET_SIZE - 1)
+        /* cells with their own RGB colors get a packet each */
+
+        if (attr != old_attr || i == MAX_PACKET_SIZE - 1
+                    || (i && ((attr | old_attr) & PDC_RGB_CELL)))
         {
-            if (_new_packet(old_attr, i, x, lineno, text) == ERR)
+            if (_new_packet(old_attr, i, x, lineno,
+                            (rgb_row ? rgb_row + x * 2 : NULL), text) == ERR)
                 return;
 
             old_attr = attr;
@@ -409,10 +1140,38 @@ void PDC_transform_line(int lineno, int x, int len, const chtype *srcp)
 #endif
     }
 
-    _new_packet(old_attr, i, x, lineno, text);
+    _new_packet(old_attr, i, x, lineno, (rgb_row ? rgb_row + x * 2 : NULL),
+                text);
+    _flush_text();
+}
+
+/* Send the queued requests to the server, without waiting for it to
+   process them -- unless more than requestsInFlight have gone out
+   since the last one it's known to have processed, in which case, wait
+   (XSync()), so that a client drawing faster than the server or the
+   network can keep up with doesn't get arbitrarily far ahead. (Replies
+   and events, as well as XSync() itself, tell Xlib how far it's got.)
+   With requestsInFlight <= 0, always wait, as PDCurses used to. */
+
+void PDC_flush_display(void)
+{
+    Display *display = XtDisplay(pdc_toplevel);
+    const int limit = pdc_app_data.requestsInFlight;
+    unsigned long in_flight;
+
+    PDC_update_window();
+
+    in_flight = XNextRequest(display) - 1
+              - LastKnownRequestProcessed(display);
+
+    if (limit <= 0 || in_flight > (unsigned long)limit)
+        XSync(display, False);
+    else
+        XFlush(display);
 }
 
 void PDC_doupdate(void)
 {
-    XSync(XtDisplay(pdc_toplevel), False);
+    PDC_check_blink_timer();
+    PDC_flush_display();
 }
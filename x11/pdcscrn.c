@@ -106,7 +106,9 @@ static XtResource app_resources[] =
     RINT(cursorBlinkRate, CursorBlinkRate, 0),
 
     RSTRING(textCursor, TextCursor),
-    RINT(textBlinkRate, TextBlinkRate, 500)
+    RINT(textBlinkRate, TextBlinkRate, 500),
+    RINT(requestsInFlight, RequestsInFlight, 8192),
+    RSTRING(textRendering, TextRendering)
 };
 
 #undef RCURSOR
@@ -132,6 +134,7 @@ static XrmOptionDescRec options[] =
     COPT(clickPeriod), COPT(doubleClickPeriod), COPT(scrollbarWidth),
     COPT(pointerForeColor), COPT(pointerBackColor),
     COPT(cursorBlinkRate), COPT(textCursor), COPT(textBlinkRate),
+    COPT(requestsInFlight), COPT(textRendering),
 
     CCOLOR(Black), CCOLOR(Red), CCOLOR(Green), CCOLOR(Yellow),
     CCOLOR(Blue), CCOLOR(Magenta), CCOLOR(Cyan), CCOLOR(White),
@@ -148,7 +151,7 @@ XCursesAppData pdc_app_data;
 XtAppContext pdc_app_context;
 Widget pdc_toplevel, pdc_drawing;
 
-GC pdc_normal_gc, pdc_cursor_gc, pdc_italic_gc, pdc_bold_gc;
+GC pdc_cursor_gc;
 int pdc_fheight, pdc_fwidth, pdc_fascent, pdc_fdescent;
 int pdc_wwidth, pdc_wheight;
 bool pdc_window_entered = TRUE, pdc_resize_now = FALSE, pdc_return_window_close_as_key = FALSE;
@@ -192,21 +195,8 @@ void PDC_scr_free(void)
         icon_pixmap_mask = 0;
     }
 
-    if( pdc_normal_gc)
-    {
-        XFreeGC(XCURSESDISPLAY, pdc_normal_gc);
-        pdc_normal_gc = NULL;
-    }
-    if( pdc_italic_gc)
-    {
-        XFreeGC(XCURSESDISPLAY, pdc_italic_gc);
-        pdc_italic_gc = NULL;
-    }
-    if( pdc_bold_gc)
-    {
-        XFreeGC(XCURSESDISPLAY, pdc_bold_gc);
-        pdc_bold_gc = 0;
-    }
+    PDC_free_gc_cache();
+    PDC_free_backing();
     if( pdc_cursor_gc)
     {
         XFreeGC(XCURSESDISPLAY, pdc_cursor_gc);
@@ -334,6 +324,7 @@ static void _display_screen(void)
         PDC_transform_line(row, 0, COLS, curscr->_y[row]);
 
     PDC_redraw_cursor();
+    PDC_update_window();
 }
 
 static void _handle_expose(Widget w, XtPointer client_data, XEvent *event,
@@ -344,14 +335,19 @@ static void _handle_expose(Widget w, XtPointer client_data, XEvent *event,
     INTENTIONALLY_UNUSED_PARAMETER( w);
     INTENTIONALLY_UNUSED_PARAMETER( client_data);
     INTENTIONALLY_UNUSED_PARAMETER( unused);
-    /* ignore all Exposes except last */
 
-    if (event->xexpose.count)
+    if (!event->xexpose.count)
+        exposed = TRUE;
+
+    if (!received_map_notify)
         return;
 
-    exposed = TRUE;
+    /* Copy the exposed area from the backing pixmap -- or, if nothing
+       has been drawn there yet, redraw the screen after the last Expose */
 
-    if (received_map_notify)
+    if (!PDC_copy_from_backing(event->xexpose.x, event->xexpose.y,
+                               event->xexpose.width, event->xexpose.height)
+        && !event->xexpose.count)
         _display_screen();
 }
 
@@ -408,6 +404,7 @@ static void _handle_enter_leave(Widget w, XtPointer client_data,
            not current */
 
         PDC_redraw_cursor();
+        PDC_update_window();
         break;
 
     default:
@@ -505,7 +502,6 @@ void PDC_set_args(int c, char **v)
 
 int PDC_scr_open(void)
 {
-    bool italic_font_valid, bold_font_valid;
     int minwidth, minheight;
 
     PDC_LOG(("PDC_scr_open() - called\n"));
@@ -540,14 +536,6 @@ int PDC_scr_open(void)
     pdc_fdescent = pdc_app_data.normalFont->descent;
     pdc_fheight = pdc_fascent + pdc_fdescent;
 
-    /* Check that the italic font and normal fonts are the same size */
-
-    italic_font_valid = pdc_fwidth ==
-        pdc_app_data.italicFont->max_bounds.width;
-
-    bold_font_valid = pdc_fwidth ==
-        pdc_app_data.boldFont->max_bounds.width;
-
     /* Calculate size of display window */
 
     if( _override_lines && _override_cols)
@@ -650,19 +638,12 @@ int PDC_scr_open(void)
     XSetWMProtocols(XtDisplay(pdc_toplevel), XtWindow(pdc_toplevel),
                     wm_atom, 2);
 
-    /* Create the Graphics Context for drawing. This MUST be done AFTER
-       the associated widget has been realized. */
+    /* Create the Graphics Context for the cursor. This MUST be done AFTER
+       the associated widget has been realized. (Those for text are made
+       as needed, by PDC_transform_line().) */
 
     PDC_LOG(("before _get_gc\n"));
 
-    _get_gc(&pdc_normal_gc, pdc_app_data.normalFont, COLOR_WHITE, COLOR_BLACK);
-
-    _get_gc(&pdc_italic_gc, italic_font_valid ? pdc_app_data.italicFont :
-            pdc_app_data.normalFont, COLOR_WHITE, COLOR_BLACK);
-
-    _get_gc(&pdc_bold_gc, bold_font_valid ? pdc_app_data.boldFont :
-            pdc_app_data.normalFont, COLOR_WHITE, COLOR_BLACK);
-
     _get_gc(&pdc_cursor_gc, pdc_app_data.normalFont,
             COLOR_WHITE, COLOR_BLACK);
 
@@ -51,6 +51,7 @@ int PDC_curs_set(int visibility)
 
     PDC_display_cursor(SP->cursrow, SP->curscol, SP->cursrow,
                        SP->curscol, visibility);
+    PDC_update_window();
 
     return ret_vis;
 }
@@ -76,8 +77,7 @@ int PDC_set_blink(bool blinkon)
         {
             SP->termattrs |= A_BLINK;
             pdc_blinked_off = FALSE;
-            XtAppAddTimeOut(pdc_app_context, pdc_app_data.textBlinkRate,
-                            PDC_blink_text, NULL);
+            PDC_check_blink_timer();
         }
     }
     else if (SP->termattrs & A_BLINK)
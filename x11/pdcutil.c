@@ -17,7 +17,7 @@ void PDC_napms(int ms)
 {
     PDC_LOG(("PDC_napms() - called: ms=%d\n", ms));
 
-    XSync(XtDisplay(pdc_toplevel), False);
+    PDC_flush_display();
 
 #if defined(HAVE_USLEEP)
 
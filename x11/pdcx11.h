@@ -57,6 +57,8 @@ typedef struct
     int cursorBlinkRate;
     char *textCursor;
     int textBlinkRate;
+    int requestsInFlight;
+    char *textRendering;
 } XCursesAppData;
 
 extern XIC pdc_xic;
@@ -66,7 +68,7 @@ extern XCursesAppData pdc_app_data;
 extern XtAppContext pdc_app_context;
 extern Widget pdc_toplevel, pdc_drawing;
 
-extern GC pdc_normal_gc, pdc_cursor_gc, pdc_italic_gc, pdc_bold_gc;
+extern GC pdc_cursor_gc;
 extern int pdc_fheight, pdc_fwidth, pdc_fascent, pdc_fdescent;
 extern int pdc_wwidth, pdc_wheight;
 
@@ -77,6 +79,12 @@ int PDC_display_cursor(int, int, int, int, int);
 
 void PDC_blink_cursor(XtPointer, XtIntervalId *);
 void PDC_blink_text(XtPointer, XtIntervalId *);
+void PDC_check_blink_timer(void);
+void PDC_flush_display(void);
+void PDC_free_gc_cache(void);
+void PDC_update_window(void);
+bool PDC_copy_from_backing(int, int, int, int);
+void PDC_free_backing(void);
 int PDC_kb_setup(void);
 void PDC_redraw_cursor(void);
 bool PDC_scrollbar_init(const char *);